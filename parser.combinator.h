@@ -1,1214 +1,6596 @@
-// Parsers using combinatory parsing (rather than manual recursive-descent parsing)
-// dzchoi,
-// Apr/20/15, first working version
-// Apr/21/15, :%s/shared_ptr/shared_ptr/g
-// Apr/21/15, fix to return for first parser failure in parser_cat and parser_seq
-// Apr/25/15, renamed apply(p, f) to "p >> f" and f can be a parsing function as well as
-//	      a normal function
-
-#include <istream> // for std::istream, ...
-#include <memory> // for std::shared_ptr
-#include <string> // for std::string
-
-// A parser is a functor(mapping) of an istream to a parse tree; it is working on istream
-// rather than the lower-level streambuf for directly referencing and manipulating the
-// failbit and the eofbit.
-// Like Parsec in Haskell, there are two kinds of failures:
-// - "weak failure" or "failure but consume nothing", if a parser is failed at the very
-//   first character, the parser does not throw an exception but returns a default value
-//   (like nullptr) instead, with making the istream failed and not consuming the first
-//   character.
-// - "error failure", if a parser is failed at the second or later character, the parser
-//   throws an exception whether or not the first character was matched and consumed.
-// - this differentiation helps to write a (sub-)parser for LL(1) without try_().
-
-// references:
-// - "An Introduction to the Parsec Library",
-//   https://kunigami.wordpress.com/2014/01/21/an-introduction-to-the-parsec-library/
-// - "jneen/parsimmon", https://github.com/jneen/parsimmon
-// - "keean/Parser-Combinators", https://github.com/keean/Parser-Combinators
-// - "Stupid Template Tricks - Pride and Parser Combinators",
-//   http://blog.mattbierner.com/stupid-template-tricks-pride-and-parser-combinators-part-one/
-// - C++ containers member function table
-//   http://en.cppreference.com/w/cpp/container
-// - "Packat Parsing: Simple, Powerful, Lazy, Linear Time",
-//   http://pdos.csail.mit.edu/~baford/packrat/icfp02/
-// - "Getting Lazy with C++", http://bartoszmilewski.com/2014/04/21/getting-lazy-with-c/ 
-// - "C++11: STD::FUNCTION AND STD::BIND",
-//   http://oopscenities.net/2012/02/24/c11-stdfunction-and-stdbind/
-// - "Higher-Order Functions in C++",
-//   https://forfunand.wordpress.com/2012/04/09/higher-order-functions-in-c/
-// - "How to get the line number from a file in C++?",
-//   http://stackoverflow.com/questions/4813129/how-to-get-the-line-number-from-a-file-in-c
-// - "substream from istream",
-//   http://stackoverflow.com/questions/7623277/substream-from-istream
-// - "Copy, load, redirect and tee using C++ streambufs",
-//   http://wordaligned.org/articles/cpp-streambufs
-// - "A beginner's guide to writing a custom stream buffer (std::streambuf)",
-//   http://www.mr-edd.co.uk/blog/beginners_guide_streambuf
-// - "Tips and tricks for using C++ I/O (input/output)",
-//   http://www.augustcouncil.com/~tgibson/tutorial/iotips.html
-
-// TODO:
-// - a parser combinator (,) combining parser results into a tuple and passing it to a
-//   variadic function (C++11 required)
-
-// character parsers:
-// chr('c')
-// any_chr()	    - /./
-// one_of("abc")   - /[abc]/
-// none_of("abc")  - /[^abc]/
-// blank()	    - space or tab
-// letter()
-// alphanum()
-// digit()
-
-// void parsers:
-// eof()
-// skip(p)	    - generic void parser
-// skip('c')
-// skip("abc")
-// blanks()	    - optionally consume blanks
-
-// string parsers:
-// +p		    - convert a character parser into a string parser
-// p + q	    - concatenate string parsers
-
-// parser combinators:
-// p >> f	    - parse p, and if p succeeds apply T f(U) to the result U from p;
-//		      p can be a void parser (and f is of type T f())
-// p >> f	    - for custom parsering function f of type T f(istream &, U) or
-//		      T f(istream &)
-// many<C>(p)	    - parse /p*/ and return the collection of results from p's in a
-//		      container of type C
-// many(p)	    - string parser when p is a character parser
-// many(p)	    - void parser when p is a void parser
-// many1(p, f)	    - parse /p+/ and return the collection of results from p's using
-//		      T f(T, T) such as foldl1() in Haskell
-// many1(p)	    - void parser when p is a void parser
-// p > q	    - return result from q if p and q are parsed successfully; p can be
-//		      a void parser; return result from p if q is a void parser
-// sep_by<C>(p, q)  - parse /(p (q p)*)?/ and return the collection of results from p's
-//		      in a container of type C
-// sep_by(p, q)	    - string parser when p is a character parser
-// sep_by(p, q)	    - void parser when p is a void parser
-// sep_by1(p, q, f) - parse /p (q p)*/ and return the collection of results from p's
-//		      using T f(T, T)
-// sep_by1(p, q)    - void parser when p is a void parser
-// p | q	    - parse p first, and if p fails and consumes nothing parse q
-// try_(p)	    - parse p, and backtrack the istream if "error failure" (but istream
-//		      remains marked as failure)
-
-// TODO:
-// - other name for try_()? lookahead?
-
-// ToThink:
-// - always the recursive-descent version of parser
-// - match_and := sep_by1(match_seq, blanks() >> skip('&'), regex_and)
-// - match_id := apply( lookup,
-//		(chr('_') | letter()) + many(chr('_') | alphanum()) )
-// - blanks() := many(one_of(" \t"), skip) where skip is a void-function
-//   or blanks() := many(skip(blank()))
-// - !{symbol_alias|symbol_alias|...} :=
-//   skip('!') > skip('{') > sep_by1(match_id, blanks() > skip('|'), aliases) > skip('}')
-// - variadic apply(f, p, q, ...)
-
-
-
-#include <streambuf> // for std::streambuf
-
-// pos_stream derives streambuf and contains an additional Pos object
-class pos_stream : public std::streambuf {
-protected:
-    std::streambuf *const sbuf;
-
-    std::streambuf::int_type underflow() { return sbuf->sgetc(); }
-
-    std::streambuf::int_type uflow() { return c = sbuf->sbumpc(); }
-	// Note uflow() is not called for reading out eof.
-
-    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way,
-	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
-    {
-	// Note istream(not streambuf) implements tellg() as seekoff(0, ios_base::cur).
-	return sbuf->pubseekoff(off, way, which);
-    }
-
-    std::streampos seekpos(std::streampos pos,
-	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
-    {
-	return sbuf->pubseekpos(pos, which);
-    }
-
-public:
-    // Pos keeps track of the current reading position. Parsec in Haskell has every
-    // parser get a pos as an argument and return a pos as a result. However, we here
-    // include into a streambuf the pos that is updated by request, update(); the pos
-    // here gets updated manually to accomodate streambufs that do not enable seekoff()
-    // and seekpos(). For automatic updates, uflow() would take the responsibility of
-    // advancing the pos, and seekoff(), seekpos() and pbackfail() should also take care
-    // of rewinding the pos and besides the case the nested streambuf itself might not
-    // enable seekoff() and seekpos() should be considered.
-    struct Pos {
-	std::streamoff off; // tracks file position like istream::tellg()
-	int row, col; // cursor position
-
-	Pos() : off(0), row(1), col(1) {}
-	// the default functions will do enough
-	//Pos(const Pos &p) : off(p.off), row(p.row), col(p.col) {}
-	//void operator=(const Pos &p) { off = p.off; row = p.row; col = p.col; }
-
-	void update(char c) {
-	    off++;
-	    if ( c == '\t' )
-		col += 8 - (col-1) % 8;
-	    else if ( c == '\n' )
-		row++, col = 1;
-	    else
-		col++;
-	}
-    } pos;
-
-    char c; // last character read
-
-    pos_stream(std::streambuf *sbuf) : sbuf(sbuf) {}
-};
-
-// typing savers for static_cast<pos_stream *>(s.rdbuf())
-inline void update_pos(std::istream &s)
-{
-    pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
-    ps->pos.update(ps->c);
-}
-
-inline std::streamoff tellg(std::istream &s, std::streamoff since)
-// similar to s.tellg() but also work for istreams that disables it
-{
-    return static_cast<pos_stream *>(s.rdbuf())->pos.off - since;
-}
-
-inline pos_stream::Pos &pos(std::istream &s)
-{
-    return static_cast<pos_stream *>(s.rdbuf())->pos;
-}
-
-// exception for a parsing error
-struct ParserError {};
-
-// macros to help throwing exceptions
-#define MARK	std::streamoff _off(tellg(s, 0))
-
-#define CHECK \
-    if ( s.fail() && tellg(s, _off) ) \
-	throw ParserError(); \
-    else
-
-#define RETURN(...) \
-    do { \
-	if ( s.fail() && tellg(s, _off) ) \
-	    throw ParserError(); \
-	return __VA_ARGS__; \
-    } while( false )
-    // throw exception only if fail and consume nothing
-    // RETURN(x) equals CHECK; return x;
-
-#define RETURN_IF_FAIL(...) \
-    if ( s.fail() ) { \
-	if ( tellg(s, _off) ) \
-	    throw ParserError(); \
-	return __VA_ARGS__; \
-    } else
-    // throw exception only if fail and consume nothing
-    // RETURN() and RETURN_IF_FAIL() is designed to be close to a statement (though not
-    // a function) that can be nested in another statement.
-
-
-
-/* // for supporting function parsers that are not so useful as parsing functions
-template <typename T, typename U =void>
-// parser of type T(U)
-class parser {
-public:
-    virtual T operator()(std::istream &, U) const =0; // a parser is just a function
-    virtual ~parser() {}
-};
-
-template <typename T>
-// T is the result type(a parse tree normally) of parser
-class parser<T, void> {
-public:
-    virtual T operator()(std::istream &) const =0; // a parser is just a function
-    virtual ~parser() {}
-};
-*/
-
-template <typename T>
-// T is the result type(a parse tree normally) of parser
-class parser {
-public:
-    virtual T operator()(std::istream &) const =0; // a parser is just a function
-    virtual ~parser() {}
-};
-
-// cin >> p: apply a parser to an istream
-template <typename T>
-inline T operator>>(std::istream &s, const std::shared_ptr<parser<T>> &p)
-{
-    // p is declared of a const reference type not to affect its memory allocation
-    return p->operator()(s);
-}
-
-template <> // function template specialization
-inline void operator>>(std::istream &s, const std::shared_ptr<parser<void>> &p)
-{
-    p->operator()(s);
-}
-
-/* // provided in C++ by default??
-// cin >> f for a parsing function f
-template <typename T>
-inline T operator>>(std::istream &s, T (*f)(std::istream &))
-{
-    return f(s);
-}
-*/
-
-
-
-// abstract character-matching parser
-class parser_match : public parser<char> {
-protected:
-    virtual bool match(char) const =0;
-
-public:
-    char operator()(std::istream &s) const override {
-	if ( s.fail() )
-	    // Note fail() == failbit | badbit and failbit is independent of the eofbit.
-	    throw ParserError(); // expecting 'c'
-
-	const char c = s.peek();
-	if ( match(c) ) { // may possibly set eofbit
-	    s.ignore(); // consume 'c'
-	    update_pos(s);
-	    return c;
-	}
-
-	s.setstate(std::ios::failbit); // mark failure
-	return char(); // return 0 if not matched
-    }
-
-    virtual ~parser_match() {}
-};
-
-
-
-class parser_chr : public parser_match {
-protected:
-    const char c;
-    bool match(char c) const override { return c == parser_chr::c; }
-
-public:
-    parser_chr(char c) : c(c) {}
-};
-
-// chr('c'): character-matching parser
-inline std::shared_ptr<parser<char>> chr(char c)
-{
-    return std::shared_ptr<parser<char>>(new parser_chr(c));
-}
-
-
-
-class parser_any_char : public parser_match {
-protected:
-    bool match(char) const override { return true; }
-
-public:
-    parser_any_char() {}
-};
-
-// any_chr(): /./
-inline std::shared_ptr<parser<char>> any_chr()
-{
-    return std::shared_ptr<parser<char>>(new parser_any_char());
-}
-
-
-
-#include <cstring> // for strchr()
-
-class parser_one_of : public parser_match {
-protected:
-    const char *const s;
-    bool match(char c) const override { return strchr(s, c); }
-
-public:
-    parser_one_of(const char *s) : s(s) {}
-};
-
-// one_of("abc"): /[abc]/
-inline std::shared_ptr<parser<char>> one_of(const char *s)
-{
-    return std::shared_ptr<parser<char>>(new parser_one_of(s));
-}
-
-
-
-class parser_none_of : public parser_match {
-protected:
-    const char *const s;
-    bool match(char c) const override { return !strchr(s, c); }
-
-public:
-    parser_none_of(const char *s) : s(s) {}
-};
-
-// none_of("abc"): /[^abc]/
-inline std::shared_ptr<parser<char>> none_of(const char *s)
-{
-    return std::shared_ptr<parser<char>>(new parser_none_of(s));
-}
-
-// blank(): /[ \t]/
-inline std::shared_ptr<parser<char>> blank() { return one_of(" \t"); }
-    // could use isblank() if in C++11
-
-
-
-#include <cctype> // for isalpha(), isalnum(), isdigit()
-
-class parser_fmatch : public parser_match {
-protected:
-    int (*const f)(int);
-    bool match(char c) const override { return f(c); }
-
-public:
-    parser_fmatch(int (*f)(int)) : f(f) {}
-};
-
-// letter()
-inline std::shared_ptr<parser<char>> letter()
-{
-    return std::shared_ptr<parser<char>>(new parser_fmatch(isalpha));
-}
-
-// alphanum()
-inline std::shared_ptr<parser<char>> alphanum()
-{
-    return std::shared_ptr<parser<char>>(new parser_fmatch(isalnum));
-}
-
-// digit()
-inline std::shared_ptr<parser<char>> digit()
-{
-    return std::shared_ptr<parser<char>>(new parser_fmatch(isdigit));
-}
-
-
-
-class parser_eof : public parser<void> {
-public:
-    void operator()(std::istream &s) const override {
-	if ( s.fail() )
-	    throw ParserError(); // expecting eof
-
-	if ( !(s.eof() || s.peek() == EOF) ) // may possibly set eofbit
-	    s.setstate(std::ios::failbit); // mark failure if not eof
-	// no need for s.ignore() and s.rdbuf()->update() on eof
-    }
-
-    parser_eof() {}
-};
-
-// eof()
-inline std::shared_ptr<parser<void>> eof()
-{
-    return std::shared_ptr<parser<void>>(new parser_eof());
-}
-//inline std::shared_ptr<parser<void>> eof() { return skip(EOF); }
-    // This is not working because after peeking eof s.ignore() will mark the failbit.
-
-
-
-template <typename T>
-class parser_skip : public parser<void> {
-protected:
-    const std::shared_ptr<parser<T>> p;
-
-public:
-    void operator()(std::istream &s) const override { p->operator()(s); }
-
-    parser_skip(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
-};
-
-// skip(p): parse p and return nothing
-template <typename T>
-inline std::shared_ptr<parser<void>> skip(std::shared_ptr<parser<T>> p)
-{
-    return std::shared_ptr<parser<void>>(new parser_skip<T>(std::move(p)));
-}
-
-// skip('c'): character-matching void parser
-inline std::shared_ptr<parser<void>> skip(char c) { return skip(chr(c)); }
-
-
-
-class parser_str : public parser<void> {
-protected:
-    const char *const s;
-
-public:
-    void operator()(std::istream &s) const override {
-	if ( s.fail() )
-	    throw ParserError(); // expecting s
-
-	MARK;
-	for ( const char *t = parser_str::s ; *t ; t++ )
-	    if ( s.peek() == *t ) {
-		s.ignore(); // consume *t
-		update_pos(s);
-	    }
-	    else {
-		s.setstate(std::ios::failbit);
-		RETURN(); // result in "weak failure" or "error failure"
-		    // redundant to check for s.fail() within RETURN()
-	    }
-	// do nothing if parser_str::s is empty
-    }
-
-    parser_str(const char *s) : s(s) {}
-};
-
-// skip("abc"): string-matching void parser
-// skip("abc") equals "skip('a') >> skip('b') >> skip('c')"
-inline std::shared_ptr<parser<void>> skip(const char *s)
-{
-    return std::shared_ptr<parser<void>>(new parser_str(s));
-}
-
-
-
-template <typename U, typename T>
-class parser_map : public parser<T> {
-protected:
-    const std::shared_ptr<parser<U>> p;
-    T (*const f)(U);
-
-public:
-    T operator()(std::istream &s) const override {
-	U u(p->operator()(s)); //or const U &u??
-	if ( s.fail() )
-	    return T(); // return the default value of T if failed
-	return f(u);
-    }
-
-    parser_map(std::shared_ptr<parser<U>> p, T (*f)(U)) : p(std::move(p)), f(f) {}
-};
-
-// "p >> f": parse p, and if p succeeds apply T f(U) to the result from p
-// operator>() could be used rather than operator>>(), but for the sake of readability
-template <typename U, typename T>
-inline std::shared_ptr<parser<T>> operator>>(std::shared_ptr<parser<U>> p, T (*f)(U))
-{
-    return std::shared_ptr<parser<T>>(new parser_map<U, T>( std::move(p), f ));
-}
- 
-template <typename T>
-class parser_map<void, T> : public parser<T> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-    T (*const f)();
-
-public:
-    T operator()(std::istream &s) const override {
-	p->operator()(s);
-	if ( s.fail() )
-	    return T(); // return the default value of T if failed
-	return f();
-    }
-
-    parser_map(std::shared_ptr<parser<void>> p, T (*f)()) : p(std::move(p)), f(f) {}
-};
-
-// "p >> f" when p is a void parser; that is, "p >> return f()" in Haskell
-template <typename T>
-inline std::shared_ptr<parser<T>> operator>>(std::shared_ptr<parser<void>> p, T (*f)())
-// overloading necessary since U of T (*f)(U) cannot be deduced as void from T(*f)()
-{
-    return std::shared_ptr<parser<T>>(new parser_map<void, T>( std::move(p), f ));
-}
-
-
-
-class parser_cat : public parser<std::string> {
-protected:
-    const std::shared_ptr<parser<std::string>> p;
-    const std::shared_ptr<parser<std::string>> q;
-
-public:
-    std::string operator()(std::istream &s) const override {
-	MARK;
-	std::string t(p->operator()(s));
-	if ( !s.fail() ) {
-	    t.append(q->operator()(s));
-	    CHECK;
-	}
-	return t;
-    }
-
-    parser_cat(
-	std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<std::string>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// "p + q": concatenation of string parsers
-inline std::shared_ptr<parser<std::string>> operator+(
-    std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<std::string>> q)
-{
-    return std::shared_ptr<parser<std::string>>(new parser_cat(
-	std::move(p), std::move(q) ));
-}
-
-inline std::string char_to_string(char c) { return std::string(1, c); }
-
-// "+p": unary operator for converting a character parser into a string parser
-inline std::shared_ptr<parser<std::string>> operator+(std::shared_ptr<parser<char>> p)
-{
-    return std::move(p) >> char_to_string;
-}
-
-// "p + q" when p is a character parser
-inline std::shared_ptr<parser<std::string>> operator+(
-    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<std::string>> q)
-{
-    return +std::move(p) + std::move(q);
-}
-
-// "p + q" when q is a character parser
-inline std::shared_ptr<parser<std::string>> operator+(
-    std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<char>> q)
-{
-    return std::move(p) + +std::move(q);
-}
-
-// "p + q" when both are character parsers
-inline std::shared_ptr<parser<std::string>> operator+(
-    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<char>> q)
-{
-    return +std::move(p) + +std::move(q);
-}
-
-
-
-template <class C>
-// T(== C::value_type) is type of the result from p, C is type of a (generic) container
-// for Ts.
-class parser_many : public parser<C> {
-protected:
-    const std::shared_ptr<parser<typename C::value_type>> p;
-	// parser to apply repeatedly
-
-public:
-    C operator()(std::istream &s) const override {
-	for ( C c ;; ) {
-	    C::value_type t(p->operator()(s)); //or const C::value_type &t??
-	    if ( s.fail() )
-		// recover failure, since the failure is used to check only for the end
-		// of the combined parser and the combined parser will always result in
-		// success as an optional parser.
-		return s.clear(), c; // c is passed by copying
-	    c.insert(c.end(), t); // build up result
-	}
-    }
-
-    parser_many(std::shared_ptr<parser<typename C::value_type>> p)
-    : p(std::move(p)) {}
-};
-
-// many<C>(p): parse /p*/ and return the collection of results from p's in a C container
-template <class C>
-inline std::shared_ptr<parser<C>> many(std::shared_ptr<parser<typename C::value_type>> p)
-{
-    return std::shared_ptr<parser<C>>(new parser_many<C>( std::move(p) ));
-}
-
-// many(p) when p is a character parser
-inline std::shared_ptr<parser<std::string>> many(std::shared_ptr<parser<char>> p)
-// no specialization "template <>", otherwise the compiler could not deduce C from the
-// element type C::value_type; e.g., std::vector<char> and std::string have the same
-// value_type.
-{
-    return many<std::string>(std::move(p));
-    // equivalently,
-    //return std::shared_ptr<parser<std::string>>(new parser_many<std::string>(
-	//std::move(p) ));
-}
-
-template <>
-class parser_many<void> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-
-public:
-    void operator()(std::istream &s) const override {
-	do p->operator()(s);
-	while ( !s.fail() );
-	s.clear();
-    }
-
-    parser_many(std::shared_ptr<parser<void>> p) : p(std::move(p)) {}
-};
-
-// many(p) when p is a void parser
-inline std::shared_ptr<parser<void>> many(std::shared_ptr<parser<void>> p)
-{
-    return std::shared_ptr<parser<void>>(new parser_many<void>( std::move(p) ));
-}
-
-// blanks(): optional void parser consuming blanks
-inline std::shared_ptr<parser<void>> blanks()
-{
-    return many(skip(blank()));
-}
-
-
-
-template <typename T>
-class parser_many1 : public parser<T> {
-protected:
-    const std::shared_ptr<parser<T>> p;
-    T (*const f)(T, T); // combiner
-
-public:
-    T operator()(std::istream &s) const override {
-	T c(p->operator()(s));
-	if ( s.fail() )
-	    return c; // we must parse p at least once
-	for ( ;; ) {
-	    T t(p->operator()(s)); //or const T &t??
-	    if ( s.fail() )
-		// recover failure, since the failure is used to check only for the end
-		// of the combined parser and the combined parser will result in success
-		// for 2nd or later parse failure.
-		return s.clear(), c; // c is passed by copying
-	    c = f(c, t); // build up result
-	}
-    }
-
-    parser_many1(std::shared_ptr<parser<T>> p, T (*f)(T, T)) : p(std::move(p)), f(f) {}
-};
-
-// many1(p, f): parse /p+/ and return the collection of results from p's using T f(T, T)
-template <typename T>
-inline std::shared_ptr<parser<T>> many1(std::shared_ptr<parser<T>> p, T (*f)(T, T))
-{
-    return std::shared_ptr<parser<T>>(new parser_many1<T>( std::move(p), f ));
-}
-
-template <>
-class parser_many1<void> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-
-public:
-    void operator()(std::istream &s) const override {
-	p->operator()(s);
-	if ( !s.fail() ) { // we must parse p at least once
-	    do p->operator()(s);
-	    while ( !s.fail() );
-	    s.clear();
-	}
-    }
-
-    parser_many1(std::shared_ptr<parser<void>> p) : p(std::move(p)) {}
-};
-
-// many1(p) when p is a void parser
-inline std::shared_ptr<parser<void>> many1(std::shared_ptr<parser<void>> p)
-{
-    return std::shared_ptr<parser<void>>(new parser_many1<void>( std::move(p) ));
-}
-
-// many1(p) for a character parser p and more general many1<C>(p) are not provided as now
-
-
-
-/* // for supporting function parsers that are not so useful as parsing functions
-template <typename U, typename T>
-class parser_chain : public parser<T> {
-protected:
-    const std::shared_ptr<parser<U>> p;
-    const std::shared_ptr<parser<T, U>> q;
-
-public:
-    T operator()(std::istream &s) const override {
-	MARK;
-	U u(p->operator()(s)); //or const U &u??
-	if ( s.fail() )
-	    return T();
-	T t(q->operator()(s, u)); //or const T &t??
-	RETURN(t);
-    }
-
-    parser_chain(std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T, U>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-template <typename U, typename T>
-inline std::shared_ptr<parser<T>> operator>>(
-    std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T, U>> q)
-{
-    return std::shared_ptr<parser<T>>(new parser_chain<U, T>(
-	std::move(p), std::move(q) ));
-}
-*/
-
-// chaining a parser and a parsing(consuming stream) function (rather than a function
-// parser) since a parsing function is easier to write in C/C++ than a function parser
-// which should be defined through a derived parser class. A parsing function is the same
-// as the normal function except it takes istream & as an additional argument.
-template <typename U, typename T>
-class parser_chain : public parser<T> {
-protected:
-    const std::shared_ptr<parser<U>> p;
-    T (*const f)(std::istream &, U);
-
-public:
-    T operator()(std::istream &s) const override {
-	U u(p->operator()(s)); //or const U &u??
-	if ( s.fail() )
-	    return T(); // return the default value of T if failed
-	return f(s, u);
-    }
-
-    parser_chain(std::shared_ptr<parser<U>> p, T (*f)(std::istream &, U))
-    : p(std::move(p)), f(f) {}
-};
-
-// "p >> f": parse p, and if p succeeds apply T f(s, U) to the result U from p
-// operator>() could be used rather than operator>>(), but for the sake of readability
-template <typename U, typename T>
-inline std::shared_ptr<parser<T>> operator>>(
-    std::shared_ptr<parser<U>> p, T (*f)(std::istream &, U))
-{
-    return std::shared_ptr<parser<T>>(new parser_chain<U, T>( std::move(p), f ));
-}
-
-template <typename T>
-class parser_chain<void, T> : public parser<T> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-    T (*const f)(std::istream &);
-
-public:
-    T operator()(std::istream &s) const override {
-	p->operator()(s);
-	if ( s.fail() )
-	    return T(); // return the default value of T if failed
-	return f(s);
-    }
-
-    parser_chain(std::shared_ptr<parser<void>> p, T (*f)(std::istream &))
-    : p(std::move(p)), f(f) {}
-};
-
-// "p >> f" when p is a void parser
-template <typename T>
-inline std::shared_ptr<parser<T>> operator>>(
-    std::shared_ptr<parser<void>> p, T (*f)(std::istream &))
-// overloading necessary since U of T (*f)(U) cannot be deduced as void from T(*f)()
-{
-    return std::shared_ptr<parser<T>>(new parser_chain<void, T>( std::move(p), f ));
-}
-
-
-
-template <typename U, typename T>
-// p is a U-parser and q is a T-parser
-class parser_seq : public parser<T> {
-protected:
-    const std::shared_ptr<parser<U>> p;
-    const std::shared_ptr<parser<T>> q;
-
-public:
-    T operator()(std::istream &s) const override {
-	// p and q are parsed sequentially
-	MARK;
-	p->operator()(s);
-	if ( s.fail() )
-	    // if first parser fails we do not try second parser
-	    return T(); // whether or not U is void
-	T t(q->operator()(s)); //or const T &t??
-	RETURN(t);
-	    // throw exception if second parser fails; otherwise, a sequence of parsers
-	    // with all but the last one having succeeded would escape the outer try_().
-    }
-
-    parser_seq(std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// "p > q": return result from q if p and q are parsed successfully
-template <typename U, typename T>
-inline std::shared_ptr<parser<T>> operator>(
-    std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T>> q)
-{
-    return std::shared_ptr<parser<T>>(new parser_seq<U, T>(
-	std::move(p), std::move(q) ));
-}
-
-template <typename T>
-class parser_seq<T, void> : public parser<T> {
-protected:
-    const std::shared_ptr<parser<T>> p;
-    const std::shared_ptr<parser<void>> q;
-
-public:
-    T operator()(std::istream &s) const override {
-	MARK;
-	T t(p->operator()(s)); //or const T &t??
-	if ( !s.fail() ) {
-	    q->operator()(s);
-	    CHECK;
-	}
-	return t;
-    }
-
-    parser_seq(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<void>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-template <>
-class parser_seq<void, void> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-    const std::shared_ptr<parser<void>> q;
-
-public:
-    void operator()(std::istream &s) const override {
-	MARK;
-	p->operator()(s);
-	if ( !s.fail() ) {
-	    q->operator()(s);
-	    CHECK;
-	}
-	return;
-    }
-
-    parser_seq(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// "p > q" when q is a void parser
-template <typename T>
-inline std::shared_ptr<parser<T>> operator>(
-    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<void>> q)
-{
-    return std::shared_ptr<parser<T>>(new parser_seq<T, void>(
-	std::move(p), std::move(q) ));
-}
-
-/* // unnecessary as a plain specialization of above operator>()
-// "p > q" when both are void parsers
-template <>
-inline std::shared_ptr<parser<void>> operator>(
-    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
-{
-    return std::shared_ptr<parser<void>>(new parser_seq<void, void>(
-	std::move(p), std::move(q) ));
-}
-*/
-
-
-
-template <class C, typename U>
-// T(== C::value_type) is type of the result from p, C is type of a (generic) container
-// for Ts. U is type of the separator, usually void.
-class parser_sep_by : public parser<C> {
-protected:
-    const std::shared_ptr<parser<typename C::value_type>> p;
-	// parser to apply repeatedly
-    const std::shared_ptr<parser<U>> q; // separator
-
-public:
-    C operator()(std::istream &s) const override {
-	MARK;
-	C c;
-	C::value_type t(p->operator()(s)); //or const C::value_type &t??
-	if ( s.fail() )
-	    return s.clear(), c; // return empty container
-	c.insert(c.end(), t);
-	for ( ;; ) {
-	    q->operator()(s);
-	    if ( s.fail() )
-		// recover failure, since the failure is used to check only for the end
-		// of the combined parser and the combined parser will result in success
-		// for 2nd or later parse failure.
-		return s.clear(), c; // c is passed by copying
-	    C::value_type t(p->operator()(s)); //or const C::value_type &t??
-	    RETURN_IF_FAIL(C()); // must parse p after the separator
-		// return the default value of C if failed
-	    c.insert(c.end(), t); // build up result
-	}
-    }
-
-    parser_sep_by(
-	std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// sep_by<C>(p, q): parse /(p (q p)*)?/ and return the collection of results from p's
-// in a C container
-template <class C, typename U>
-inline std::shared_ptr<parser<C>> sep_by(
-    std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
-{
-    return std::shared_ptr<parser<C>>(new parser_sep_by<C, U>(
-	std::move(p), std::move(q) ));
-}
-
-// sep_by(p, q) when p is a character parser
-template <typename U>
-inline std::shared_ptr<parser<std::string>> sep_by(
-    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<U>> q)
-{
-    return sep_by<std::string>(std::move(p), std::move(q));
-}
-
-template <typename U>
-class parser_sep_by<void, U> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-    const std::shared_ptr<parser<U>> q; // separator
-
-public:
-    void operator()(std::istream &s) const override {
-	MARK;
-	p->operator()(s);
-	if ( !s.fail() )
-	    while ( q->operator()(s), !s.fail() ) {
-		p->operator()(s);
-		RETURN_IF_FAIL(); // must parse p after the separator
-	    }
-	s.clear(); // always success except for failure after separator
-    }
-
-    parser_sep_by(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// sep_by(p, q) when p is a void parser
-template <typename U>
-inline std::shared_ptr<parser<void>> sep_by(
-    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
-{
-    return std::shared_ptr<parser<void>>(new parser_sep_by<void, U>(
-	std::move(p), std::move(q) ));
-}
-
-
-
-/* // not provided since "many1<C>(p)" is not provided either
-template <class C, typename U>
-// T(== C::value_type) is type of the result from p, C is type of a (generic) container
-// for Ts. U is type of the separator, usually void.
-class parser_sep_by1 : public parser<C> {
-protected:
-    const std::shared_ptr<parser<typename C::value_type>> p;
-	// parser to apply repeatedly
-    const std::shared_ptr<parser<U>> q; // separator
-
-public:
-    C operator()(std::istream &s) const override {
-	MARK;
-	for ( C c ;; ) {
-	    C::value_type t(p->operator()(s)); //or const C::value_type &t??
-	    RETURN_IF_FAIL(C()); // we must parse p at least once
-		// return the default value of C if failed
-	    c.insert(c.end(), t); // build up result
-	    q->operator()(s);
-	    if ( s.fail() )
-		// recover failure, since the failure is used to check only for the end
-		// of the combined parser and the combined parser will result in success
-		// for 2nd or later parse failure.
-		return s.clear(), c; // c is passed by copying
-	}
-    }
-
-    parser_sep_by1(
-	std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// sep_by1<C>(p, q): parse /(p (q p)*)?/ and return the collection of results from p's
-// in a C container
-template <class C, typename U>
-inline std::shared_ptr<parser<C>> sep_by1(
-    std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
-{
-    return std::shared_ptr<parser<C>>(new parser_sep_by1<C, U>(
-	std::move(p), std::move(q) ));
-}
-*/
-
-template <typename T, typename U>
-// p is a T-parser and q is a U-parser(separator), U is usually void.
-class parser_sep_by1 : public parser<T> {
-protected:
-    const std::shared_ptr<parser<T>> p; // parser to apply repeatedly
-    const std::shared_ptr<parser<U>> q; // separator
-    T (*const f)(T, T); // combiner
-
-public:
-    T operator()(std::istream &s) const override {
-	MARK;
-	T c(p->operator()(s));
-	if ( s.fail() )
-	    return c; // we must parse p at least once
-	for ( ;; ) {
-	    q->operator()(s);
-	    if ( s.fail() )
-		// recover failure, since the failure is used to check only for the end
-		// of the combined parser and the combined parser will result in success
-		// for 2nd or later parse failure.
-		return s.clear(), c; // c is passed by copying
-	    T t(p->operator()(s)); //or const T &t??
-	    RETURN_IF_FAIL(T()); // must parse p after the separator
-		// return the default value of T if failed
-	    c = f(c, t); // build up result
-	}
-    }
-
-    parser_sep_by1(
-	std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, T (*f)(T, T))
-    : p(std::move(p)), q(std::move(q)), f(f) {}
-};
-
-// sep_by1(p, q, f): parse /p (q p)*/ and return the collection of results from p's
-// using T f(T, T)
-template <typename T, typename U>
-inline std::shared_ptr<parser<T>> sep_by1(
-    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, T (*f)(T, T))
-{
-    return std::shared_ptr<parser<T>>(new parser_sep_by1<T, U>(
-	std::move(p), std::move(q), f ));
-}
-
-template <typename U>
-// p is a void parser and q is a U-parser(separator), U is usually void.
-class parser_sep_by1<void, U> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p; // parser to apply repeatedly
-    const std::shared_ptr<parser<U>> q; // separator
-
-public:
-    void operator()(std::istream &s) const override {
-	MARK;
-	do {
-	    p->operator()(s);
-	    RETURN_IF_FAIL(); // we must parse p at least once
-	    q->operator()(s);
-	} while ( !s.fail() )
-	s.clear();
-    }
-
-    parser_sep_by1(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// sep_by1(p, q) when p is a void parser
-template <typename U>
-inline std::shared_ptr<parser<void>> sep_by1(
-    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
-{
-    return std::shared_ptr<parser<void>>(new parser_sep_by1<void, U>(
-	std::move(p), std::move(q) ));
-}
-
-
-
-template <typename T>
-class parser_alt : public parser<T> {
-protected:
-    const std::shared_ptr<parser<T>> p;
-    const std::shared_ptr<parser<T>> q;
-
-public:
-    T operator()(std::istream &s) const override {
-	T t(p->operator()(s)); //or const T &t??
-	if ( !s.fail() )
-	    return t;
-	s.clear();
-	    // recover failure, since the combined parser is not failed yet and now
-	    // depends on the second parser.
-	return q->operator()(s);
-    }
-
-    parser_alt(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<T>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-template <>
-class parser_alt<void> : public parser<void> {
-protected:
-    const std::shared_ptr<parser<void>> p;
-    const std::shared_ptr<parser<void>> q;
-
-public:
-    void operator()(std::istream &s) const override {
-	p->operator()(s);
-	if ( s.fail() ) {
-	    s.clear();
-	    q->operator()(s);
-	}
-    }
-
-    parser_alt(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
-    : p(std::move(p)), q(std::move(q)) {}
-};
-
-// "p | q": parse p first, and if p fails and consumes nothing parse q
-template <typename T>
-inline std::shared_ptr<parser<T>> operator|(
-    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<T>> q)
-{
-    return std::shared_ptr<parser<T>>(new parser_alt<T>(
-	std::move(p), std::move(q) ));
-}
-
-
-
-template <typename T>
-class parser_try : public parser<T> {
-protected:
-    const std::shared_ptr<parser<T>> p;
-
-public:
-    T operator()(std::istream &s) const override {
-	pos_stream::Pos saved_pos = pos(s);
-	std::streampos	tellg = s.tellg();
-	try {
-	    return p->operator()(s);
-	}
-	catch ( ParserError ) {
-	    if ( tellg != std::ios::pos_type(std::ios::off_type(-1)) ) {
-		// call seekg() only if enabled
-		s.clear(); // unnecessary if in C++11
-		s.seekg(tellg);
-		s.setstate(std::ios::failbit); // mark failure again
-		pos(s) = saved_pos;
-	    }
-	    return T(); // return the default value of T if failed
-	}
-    }
-
-    parser_try(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
-};
-
-// try_(p): parse p, and backtrack the istream if "error failure" (but istream remains
-// marked as failure)
-template <typename T>
-inline std::shared_ptr<parser<T>> try_(std::shared_ptr<parser<T>> p)
-{
-    return std::shared_ptr<parser<T>>(new parser_try<T>( std::move(p) ));
-}
+// Parsers using combinatory parsing (rather than manual recursive-descent parsing)
+// dzchoi,
+// Apr/20/15, first working version
+// Apr/21/15, :%s/shared_ptr/shared_ptr/g
+// Apr/21/15, fix to return for first parser failure in parser_cat and parser_seq
+// Apr/25/15, renamed apply(p, f) to "p >> f" and f can be a parsing function as well as
+//	      a normal function
+// Oct/18/26, take_while(), take_while1() and skip_while() scanning a character class in
+//	      bulk, and blanks() reimplemented as skip_while()
+// Oct/18/26, scan_until() and quoted() jumping to the next delimiter in bulk
+// Oct/18/26, recover(p, sync) logging errors and resynchronizing instead of aborting
+// Oct/18/26, parser_base::describe() for walking a combinator graph, and
+//	      compile_regular(p) compiling a regular parser into a dfa
+// Oct/18/26, any callables rather than function pointers for semantic actions
+// Oct/18/26, variadic seq(p, q, ...) and apply(f, p, q, ...)
+// Oct/18/26, many_each(), sep_by_each() and each() delivering results one at a time
+// Oct/18/26, tag(k, p) building a flat_tree of struct-of-arrays nodes while parsing
+// Oct/18/26, UTF-8 parsers of code points, XID classes and vectorized utf8_valid()
+// Oct/18/26, pos_stream::Budget limiting steps, depth, backtracking and time of a parse
+// Oct/18/26, share(p) hash-consing structurally identical parsers, used by the factories
+// Oct/18/26, compile_bytecode(p) compiling a grammar into bytecode for a parsing machine,
+//	      and load_bytecode() loading it back
+// Oct/18/26, parse_context and parse_batch() parsing many small documents in memory
+// Oct/18/26, traced(name, p) and try_() recording events into a trace_log exported as
+//	      Chrome trace events
+// Oct/18/26, lexer and token_stream lexing input into tokens for the parsers, optionally
+//	      on a thread running ahead of the parser
+// Oct/18/26, gzip_buf and zstd_buf decompressing input block by block with bounded rewind
+// Oct/18/26, file_buf reading a file a block ahead of the parser on a thread
+// Oct/18/26, followed_by(p), not_followed_by(p) and peek(p) looking ahead cheaply
+// Oct/18/26, container_pool recycling the containers of results across parses
+// Oct/18/26, grammar_analyzer reporting nullable loops, try_() overlaps and backtracking
+// Oct/18/26, intern(p) numbering the names parsed by p in a symbol_table
+// Oct/18/26, adaptive(p) reordering exclusive alternatives by their hits
+// Oct/18/26, expected_set noting what the parsers failing furthest expected
+
+#include <istream> // for std::istream, ...
+#include <memory> // for std::shared_ptr
+#include <string> // for std::string
+#include <cstdint> // for std::uint64_t
+
+// A parser is a functor(mapping) of an istream to a parse tree; it is working on istream
+// rather than the lower-level streambuf for directly referencing and manipulating the
+// failbit and the eofbit.
+// Like Parsec in Haskell, there are two kinds of failures:
+// - "weak failure" or "failure but consume nothing", if a parser is failed at the very
+//   first character, the parser does not throw an exception but returns a default value
+//   (like nullptr) instead, with making the istream failed and not consuming the first
+//   character.
+// - "error failure", if a parser is failed at the second or later character, the parser
+//   throws an exception whether or not the first character was matched and consumed.
+// - this differentiation helps to write a (sub-)parser for LL(1) without try_().
+
+// references:
+// - "An Introduction to the Parsec Library",
+//   https://kunigami.wordpress.com/2014/01/21/an-introduction-to-the-parsec-library/
+// - "jneen/parsimmon", https://github.com/jneen/parsimmon
+// - "keean/Parser-Combinators", https://github.com/keean/Parser-Combinators
+// - "Stupid Template Tricks - Pride and Parser Combinators",
+//   http://blog.mattbierner.com/stupid-template-tricks-pride-and-parser-combinators-part-one/
+// - C++ containers member function table
+//   http://en.cppreference.com/w/cpp/container
+// - "Packat Parsing: Simple, Powerful, Lazy, Linear Time",
+//   http://pdos.csail.mit.edu/~baford/packrat/icfp02/
+// - "Getting Lazy with C++", http://bartoszmilewski.com/2014/04/21/getting-lazy-with-c/ 
+// - "C++11: STD::FUNCTION AND STD::BIND",
+//   http://oopscenities.net/2012/02/24/c11-stdfunction-and-stdbind/
+// - "Higher-Order Functions in C++",
+//   https://forfunand.wordpress.com/2012/04/09/higher-order-functions-in-c/
+// - "How to get the line number from a file in C++?",
+//   http://stackoverflow.com/questions/4813129/how-to-get-the-line-number-from-a-file-in-c
+// - "substream from istream",
+//   http://stackoverflow.com/questions/7623277/substream-from-istream
+// - "Copy, load, redirect and tee using C++ streambufs",
+//   http://wordaligned.org/articles/cpp-streambufs
+// - "A beginner's guide to writing a custom stream buffer (std::streambuf)",
+//   http://www.mr-edd.co.uk/blog/beginners_guide_streambuf
+// - "Tips and tricks for using C++ I/O (input/output)",
+//   http://www.augustcouncil.com/~tgibson/tutorial/iotips.html
+
+// character parsers:
+// chr('c')
+// any_chr()	    - /./
+// one_of("abc")   - /[abc]/
+// none_of("abc")  - /[^abc]/
+// blank()	    - space or tab
+// letter()
+// alphanum()
+// digit()
+
+// void parsers:
+// eof()
+// skip(p)	    - generic void parser
+// skip('c')
+// skip("abc")
+// blanks()	    - optionally consume blanks
+// skip_while(cc)  - optionally consume characters of a char_class cc
+
+// span parsers (scanning a char_class cc in bulk, vectorized if SSSE3/AVX2 is enabled):
+// take_while(cc)  - /[cc]*/ as a string parser, like many(p) for a character parser p
+// take_while1(cc) - /[cc]+/ as a string parser
+// scan_until("*/") - parse /.*?\*\// and return the characters before the delimiter
+// quoted('"', '\\') - parse a quoted literal and return its body with escapes resolved
+
+// UTF-8 parsers (on code points of a utf8_class cc, e.g. xid_start() or xid_continue()):
+// utf8_char()	    - any valid code point as a char32_t
+// utf8_char(cc)   - code point of cc
+// take_while(cc)  - code points of cc as a UTF-8 string, scanning ascii ones in bulk
+// take_while1(cc) - one or more code points of cc
+// utf8_ident()	    - identifier of XID_Start (or '_') followed by XID_Continue's
+// utf8_valid(b, e) - (not a parser) the end of the valid UTF-8 prefix of [b, e), checking
+//		      16 bytes at a time if SSSE3 is enabled
+
+// string parsers:
+// +p		    - convert a character parser into a string parser
+// p + q	    - concatenate string parsers
+
+// parser combinators:
+// p >> f	    - parse p, and if p succeeds apply T f(U) to the result U from p;
+//		      p can be a void parser (and f is of type T f())
+// p >> f	    - for custom parsering function f of type T f(istream &, U) or
+//		      T f(istream &)
+//		      f (and the combiner f of many1() and sep_by1()) can be any callable
+//		      such as a lambda capturing its state, and is inlined into p >> f
+// many<C>(p)	    - parse /p*/ and return the collection of results from p's in a
+//		      container of type C
+// many(p)	    - string parser when p is a character parser
+// many(p)	    - void parser when p is a void parser
+// many1(p, f)	    - parse /p+/ and return the collection of results from p's using
+//		      T f(T, T) such as foldl1() in Haskell
+// many1(p)	    - void parser when p is a void parser
+// p > q	    - return result from q if p and q are parsed successfully; p can be
+//		      a void parser; return result from p if q is a void parser
+// seq(p1, ..., pn) - parse p's sequentially and return the std::tuple of the results
+//		      from non-void p's
+// apply(f, p1, ..., pn) - parse p's sequentially and apply f to the results from
+//		      non-void p's
+// sep_by<C>(p, q)  - parse /(p (q p)*)?/ and return the collection of results from p's
+//		      in a container of type C
+// sep_by(p, q)	    - string parser when p is a character parser
+// sep_by(p, q)	    - void parser when p is a void parser
+// sep_by1(p, q, f) - parse /p (q p)*/ and return the collection of results from p's
+//		      using T f(T, T)
+// sep_by1(p, q)    - void parser when p is a void parser
+// many_each(p, f)  - parse /p*/ and pass each result from p to f as it is parsed,
+//		      without collecting the results
+// sep_by_each(p, q, f) - parse /(p (q p)*)?/ and pass each result from p to f
+// each(s, p)	    - range of the results from p's parsed from s lazily as iterated
+// each(s, p, q)    - range of the results from p's separated by q's
+// p | q	    - parse p first, and if p fails and consumes nothing parse q
+// try_(p)	    - parse p, and backtrack the istream if "error failure" (but istream
+//		      remains marked as failure)
+// followed_by(p)   - succeed if p succeeds, consuming nothing
+// not_followed_by(p) - succeed if p fails, consuming nothing; e.g. skip("if") >
+//		      not_followed_by(alphanum()) for a keyword
+// peek(p)	    - parse p and return its result, but consume nothing
+// recover(p, cc, "rule") - parse p, and if "error failure" log the error in
+//		      errors(s), with what was expected if expected(s) is set, skip
+//		      past the next character of cc and succeed with the default value
+// tag(k, p)	    - parse p and emit a node of kind k for its span into the
+//		      flat_tree of tree(s), if set, with the nodes from p as children
+
+// interning names:
+// intern(p)	    - parse the name p returns, and return its id in the symbol_table of
+//		      symbols(s), ids being numbered from 0 in order of appearance
+// intern(p, t)	    - the same, in the symbol_table t
+// symbol_table(shared) - id(name) and name(id) of the names interned, locked by a
+//		      mutex if shared by threads
+
+// parse limits:
+// budget(s) = &b   - limit the steps, the nesting of s >> p, the bytes rewound by
+//		      try_() and the time of a parse by a pos_stream::Budget b; exceeding
+//		      one throws BudgetExceeded, which is not a ParserError
+
+// tracing parses:
+// traced("name", p) - parse p as the rule "name", recording its entry and its exit with
+//		      the offsets, times and outcome into the trace_log of trace(s) if set;
+//		      try_() also records where it rewinds from and to
+// trace_log	    - a lock-free ring of the events recorded, with write_chrome(o) to
+//		      be viewed on a timeline in chrome://tracing or Perfetto
+
+// parsing tokens:
+// lexer	    - add(k, head, tail), add(k, "lit") and
+//		      add_delimited(k, "open", "close", esc) rules of token kinds, the
+//		      longest match winning at each position
+// token_stream(lex, b, e, pipelined) - streambuf of the kinds of the tokens of [b, e),
+//		      lexed in advance or by a thread running ahead of the parser
+// tok(k)	    - token of kind k, as chr(k); one_of(), spans and try_() work as well
+// text(p)	    - parse p, and return the input spanned by the tokens p consumed
+
+// input sources:
+// gzip_buf(src, ahead, history, block) - streambuf decompressing gzip/zlib data from src
+//		      block by block, if <zlib.h> is included before this header;
+//		      rewinds by up to history bytes, and with ahead > 0 a thread
+//		      decompresses up to ahead blocks in advance
+// zstd_buf(src, ahead, history, block) - the same for zstd, if <zstd.h> is included
+// file_buf(path, ahead, history, block) - streambuf reading the file at path into the
+//		      blocks, with a thread reading ahead blocks in advance (1 by default)
+// block_buf	    - the base of them, a streambuf of the blocks from its fill(b, n)
+
+// parsing documents in memory:
+// parse_context    - parse(p, b, n) parses [b, b + n) with p into a parse_result<T> of
+//		      the status, pos, errors recovered and value, reusing one
+//		      memory_buf, pos_stream and istream for all documents,
+//		      limit(b, d) giving each document a budget of its own,
+//		      and recycle(v) giving the containers of v back to its pool
+// expected(s) = &e - note the furthest failure and the parsers failing there into the
+//		      expected_set e, whose message() tells what was expected where, e.g.
+//		      "expected ',' or ']' at 1:5"; parse_result has its own if failed;
+//		      the UTF-8 parsers note nothing
+// pool(s) = &p	    - build the results of many(), sep_by(), p + q, spans, scan_until()
+//		      and quoted() in the containers recycled into the container_pool p
+// parse_batch(p, first, last, out, threads, setup) - parse each document of
+//		      [first, last) (a std::string or anything with data() and size())
+//		      into out, on threads each with a parse_context of its own, set up
+//		      by setup(c) if given
+
+// sharing parsers:
+// share(p)	    - the live parser structurally identical to p if any, or p itself;
+//		      the factories of parsers without callables return shared parsers
+//		      (e.g. digit() == digit()), so a grammar reuses its common subparsers
+
+// analyzing grammars:
+// grammar_analyzer - nullable(p), first(p) and degree(p), the estimated worst-case
+//		      work O(n^degree), of parsers, and report(p, size) of the
+//		      grammar_issues in p: repetitions over nullable parsers, try_(p) | q
+//		      with p and q starting alike, and super-linear backtracking along
+//		      with an input of about size bytes triggering it
+// adaptive(p)	    - the chain p of "p1 | p2 | ..." trying the alternatives that
+//		      succeed the most first, if the analyzer proves them exclusive
+// adaptive("name", p, prof) - the same, counting the hits into the alt_profile prof,
+//		      which write(o) saves and read(i) loads to seed the order
+
+// parser compilers:
+// compile_regular(p) - compile p into a minimized dfa if p is regular (without semantic
+//		      actions and try_()), or return p as is otherwise
+// compile_bytecode(p) - compile p into bytecode run by a non-recursive parsing machine if
+//		      p is made of the parsers that compile_regular() takes and try_(),
+//		      or return p as is otherwise; subparsers used more than once become
+//		      subroutines
+// load_bytecode<T>(in) - T-parser of the bytecode written by program().write(out) of a
+//		      compiled T-parser, or nullptr if in does not hold one whose every
+//		      path stays in bounds with a balanced stack
+
+// TODO:
+// - other name for try_()? lookahead?
+
+// ToThink:
+// - always the recursive-descent version of parser
+// - match_and := sep_by1(match_seq, blanks() >> skip('&'), regex_and)
+// - match_id := apply( lookup,
+//		(chr('_') | letter()) + many(chr('_') | alphanum()) )
+// - blanks() := many(one_of(" \t"), skip) where skip is a void-function
+//   or blanks() := many(skip(blank()))
+// - !{symbol_alias|symbol_alias|...} :=
+//   skip('!') > skip('{') > sep_by1(match_id, blanks() > skip('|'), aliases) > skip('}')
+
+
+
+#include <streambuf> // for std::streambuf
+#include <cstring> // for memchr()
+#include <vector> // for std::vector
+#include <ostream> // for std::ostream
+
+// flat_tree is a parse tree emitted by tag(k, p) into contiguous arrays rather than
+// linked nodes on the heap. Node i has a kind, a span [off, off + len) of the input, its
+// first child and its next sibling, where nodes are numbered in preorder by 32-bit
+// indices and the roots are node 0 and its siblings. clear() frees the whole tree at
+// once, and write() and read() dump and load the arrays as they are.
+class flat_tree {
+public:
+    enum : std::uint32_t { NONE = 0xffffffffu }; // no such node
+
+    std::vector<std::uint32_t> kind;
+    std::vector<std::uint64_t> off;
+    std::vector<std::uint32_t> len;
+    std::vector<std::uint32_t> child; // first child
+    std::vector<std::uint32_t> next; // next sibling
+
+    std::uint32_t size() const { return std::uint32_t(kind.size()); }
+    std::uint32_t root() const { return kind.empty() ? std::uint32_t(NONE) : 0; }
+
+    void clear() {
+	kind.clear(), off.clear(), len.clear(), child.clear(), next.clear();
+	open = last = NONE;
+    }
+
+    // state of building, to be restored when a parser fails after emitting nodes
+    struct mark {
+	std::uint32_t size;
+	std::uint32_t open; // node whose children are being parsed
+	std::uint32_t last; // last child of open so far
+    };
+
+    mark tell() const { const mark m = { size(), open, last }; return m; }
+
+    void rollback(const mark &m) { // discard nodes emitted since m
+	if ( m.size == size() )
+	    return;
+	kind.resize(m.size), off.resize(m.size), len.resize(m.size);
+	child.resize(m.size), next.resize(m.size);
+	open = m.open, last = m.last;
+	if ( last != NONE )
+	    next[last] = NONE;
+	else if ( open != NONE )
+	    child[open] = NONE;
+    }
+
+    // begin(k, o) opens a node at offset o and end(i, m, o) closes it, where m is
+    // the mark before begin()
+    std::uint32_t begin(std::uint32_t k, std::uint64_t o) {
+	const std::uint32_t i = size();
+	kind.push_back(k), off.push_back(o), len.push_back(0);
+	child.push_back(NONE), next.push_back(NONE);
+	if ( last != NONE )
+	    next[last] = i;
+	else if ( open != NONE )
+	    child[open] = i;
+	open = i, last = NONE;
+	return i;
+    }
+
+    void end(std::uint32_t i, const mark &m, std::uint64_t o) {
+	len[i] = std::uint32_t(o - off[i]);
+	open = m.open, last = i;
+    }
+
+    void write(std::ostream &o) const {
+	const std::uint32_t n = size();
+	o.write((const char *)&n, sizeof n);
+	write(o, kind), write(o, off), write(o, len), write(o, child), write(o, next);
+    }
+
+    void read(std::istream &i) {
+	std::uint32_t n = 0;
+	i.read((char *)&n, sizeof n);
+	read(i, kind, n), read(i, off, n), read(i, len, n);
+	read(i, child, n), read(i, next, n);
+	open = last = NONE;
+    }
+
+    flat_tree() : open(NONE), last(NONE) {}
+
+private:
+    std::uint32_t open, last;
+
+    template <typename T>
+    static void write(std::ostream &o, const std::vector<T> &v) {
+	o.write((const char *)v.data(), std::streamsize(v.size() * sizeof(T)));
+    }
+
+    template <typename T>
+    static void read(std::istream &i, std::vector<T> &v, std::uint32_t n) {
+	v.resize(n);
+	i.read((char *)v.data(), std::streamsize(n * sizeof(T)));
+    }
+};
+
+#include <chrono> // for std::chrono::steady_clock
+
+// exception for exceeding a pos_stream::Budget, which is not a ParserError so that
+// neither try_() nor recover() can swallow it
+struct BudgetExceeded {
+    const char *limit; // "steps", "depth", "backtrack" or "time"
+};
+
+#include <atomic> // for std::atomic
+
+// trace_log records the events of a parse once set by trace(s) = &log: traced(name, p)
+// entering and exiting with its outcome, and try_() rewinding the input. Events go into
+// a ring of a fixed capacity, overwriting the oldest ones, where each writer claims its
+// event by an atomic increment and then its slot by the slot's sequence number, so that
+// parses in several threads can share a log without locks. The ring is best-effort: a
+// writer lapped by another one a whole capacity ahead drops its event rather than
+// overwrite a newer one. The log is to be read after the parses. write_chrome() exports
+// the events in the Chrome trace-event format, to be viewed in chrome://tracing or
+// Perfetto.
+class trace_log {
+public:
+    enum phase_t { ENTER, EXIT, REWIND };
+    enum outcome_t { OK, WEAK, ERROR }; // success, "weak failure" or "error failure"
+
+    struct event {
+	std::uint64_t ns; // since the log was created
+	std::uint64_t off; // input offset, where the input was rewound from for REWIND
+	std::uint64_t to; // input offset rewound to, for REWIND
+	const char *name; // of the rule
+	std::uint32_t tid; // thread
+	std::uint8_t phase, outcome;
+    };
+
+protected:
+    struct slot {
+	std::atomic<std::uint64_t> seq; // 2n + 1 while event n is written, 2n + 2 after
+	event e;
+
+	slot() : seq(0) {}
+    };
+
+    std::vector<slot> ring;
+    std::atomic<std::uint64_t> head; // number of events recorded in total
+    const std::chrono::steady_clock::time_point start;
+
+    static std::uint32_t thread_id() {
+	static std::atomic<std::uint32_t> n(0);
+	static thread_local const std::uint32_t id = ++n;
+	return id;
+    }
+
+    static void write_string(std::ostream &o, const char *s) {
+	static const char hex[] = "0123456789abcdef";
+	o << '"';
+	for ( ; *s ; s++ )
+	    if ( *s == '"' || *s == '\\' )
+		o << '\\' << *s;
+	    else if ( (unsigned char)*s < 0x20 )
+		o << "\\u00" << hex[*s >> 4] << hex[*s & 15];
+	    else
+		o << *s;
+	o << '"';
+    }
+
+public:
+    void record(int phase, const char *name, std::uint64_t off, int outcome =OK,
+	std::uint64_t to =0)
+    {
+	const std::chrono::nanoseconds ns = std::chrono::steady_clock::now() - start;
+	const event e = { std::uint64_t(ns.count()), off, to, name, thread_id(),
+	    std::uint8_t(phase), std::uint8_t(outcome) };
+	const std::uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+	slot &r = ring[n % ring.size()];
+	for ( std::uint64_t q = r.seq.load(std::memory_order_acquire) ; ; ) {
+	    if ( q > 2 * n )
+		return; // lapped: a newer event is written there
+	    if ( q & 1 ) // an older event still being written there
+		q = r.seq.load(std::memory_order_acquire);
+	    else if ( r.seq.compare_exchange_weak(q, 2 * n + 1,
+		std::memory_order_acquire) )
+		break;
+	}
+	r.e = e;
+	r.seq.store(2 * n + 2, std::memory_order_release);
+    }
+
+    // number of events kept, and the i-th oldest of them
+    std::uint64_t size() const {
+	const std::uint64_t h = head;
+	return h < ring.size() ? h : ring.size();
+    }
+
+    const event &operator[](std::uint64_t i) const {
+	const std::uint64_t h = head;
+	return ring[((h > ring.size() ? h - ring.size() : 0) + i) % ring.size()].e;
+    }
+
+    void clear() {
+	for ( std::size_t i = 0 ; i < ring.size() ; i++ )
+	    ring[i].seq = 0;
+	head = 0;
+    }
+
+    // write the events kept as a JSON object of Chrome trace events, where a rule is a
+    // duration from its ENTER (B) to its EXIT (E) and a rewind is an instant (i)
+    void write_chrome(std::ostream &o) const {
+	static const char *const outcomes[] = { "ok", "weak", "error" };
+	o << "{\"traceEvents\":[";
+	for ( std::uint64_t i = 0, n = size() ; i < n ; i++ ) {
+	    const event &e = (*this)[i];
+	    o << (i ? ",\n" : "\n") << "{\"name\":";
+	    write_string(o, e.name);
+	    o << ",\"ph\":\"" << (e.phase == ENTER ? 'B' : e.phase == EXIT ? 'E' : 'i')
+		<< "\",\"ts\":" << e.ns / 1000 << '.' << char('0' + e.ns / 100 % 10)
+		<< char('0' + e.ns / 10 % 10) << char('0' + e.ns % 10)
+		<< ",\"pid\":1,\"tid\":" << e.tid << ",\"args\":{\"off\":" << e.off;
+	    if ( e.phase == EXIT )
+		o << ",\"outcome\":\"" << outcomes[e.outcome] << '"';
+	    if ( e.phase == REWIND )
+		o << ",\"to\":" << e.to << ",\"rescan\":" << e.off - e.to;
+	    o << (e.phase == REWIND ? "},\"s\":\"t\"}" : "}}");
+	}
+	o << "\n]}\n";
+    }
+
+    explicit trace_log(std::size_t capacity =65536)
+    : ring(capacity ? capacity : 1), head(0), start(std::chrono::steady_clock::now()) {}
+};
+
+#include <utility> // for std::declval()
+
+// container_pool keeps the containers given back by recycle(), along with their
+// capacity, to be taken out empty by take<C>() instead of new ones; once set by pool(s)
+// = &p, the repeating combinators and string parsers build their results in them, so
+// that parsing many similar documents stops allocating as soon as the results of
+// earlier ones are recycled. Not thread-safe, like the pos_stream it is set for.
+class container_pool {
+protected:
+    struct shelf_base {
+	virtual ~shelf_base() {}
+    };
+
+    template <class C>
+    struct shelf : shelf_base {
+	std::vector<C> free;
+    };
+    std::vector<std::unique_ptr<shelf_base>> shelves; // by index<C>()
+
+    // a number for each type of container, the same for all pools
+    static std::size_t next_index() {
+	static std::atomic<std::size_t> n(0);
+	return n++;
+    }
+
+    template <class C>
+    static std::size_t index() {
+	static const std::size_t i = next_index();
+	return i;
+    }
+
+    template <class C>
+    std::vector<C> &free() {
+	const std::size_t i = index<C>();
+	if ( i >= shelves.size() )
+	    shelves.resize(i + 1);
+	if ( !shelves[i] )
+	    shelves[i].reset(new shelf<C>);
+	return static_cast<shelf<C> *>(shelves[i].get())->free;
+    }
+
+    // recycle the elements of c too if they are containers
+    template <class C>
+    void recycle_elements(C &c, decltype(std::declval<C &>().begin()->clear()) *) {
+	for ( auto &x : c )
+	    recycle(std::move(x));
+    }
+
+    template <class C>
+    void recycle_elements(C &, ...) {}
+
+    template <class C>
+    void put(C &c, decltype(std::declval<C &>().clear()) *) {
+	recycle_elements(c, nullptr);
+	c.clear();
+	std::vector<C> &f = free<C>();
+	if ( f.size() < limit )
+	    f.push_back(std::move(c));
+    }
+
+    template <class C>
+    void put(C &, ...) {} // not a container
+
+public:
+    std::size_t limit; // containers kept at most for each type
+
+    // take<C>(): an empty C, with the capacity of a recycled one if any
+    template <class C>
+    C take() {
+	std::vector<C> &f = free<C>();
+	if ( f.empty() )
+	    return C();
+	C c(std::move(f.back()));
+	f.pop_back();
+	return c;
+    }
+
+    // recycle(c): keep c emptied, and the containers in c as well
+    template <class C>
+    void recycle(C c) { put(c, nullptr); }
+
+    explicit container_pool(std::size_t limit =65536) : limit(limit) {}
+};
+
+#include <deque> // for std::deque
+#include <mutex> // for std::mutex
+
+// symbol_table numbers the names given to id() from 0 in the order first seen, so that
+// a name is stored and allocated only once; names are looked up by their bytes in an
+// open-addressing table, without making a std::string of them. A table shared by
+// threads, if so constructed, serializes id() and name() by a mutex.
+class symbol_table {
+protected:
+    std::deque<std::string> names; // by id, never moved
+    std::vector<std::uint64_t> hashes; // by id
+    std::vector<std::uint32_t> slots; // id + 1 of the names by hash, or 0 if empty
+    const bool shared;
+    mutable std::mutex m;
+
+    // FNV-1a
+    static std::uint64_t hash(const char *b, std::size_t n) {
+	std::uint64_t h = 14695981039346656037ull;
+	for ( const char *const e = b + n ; b != e ; b++ )
+	    h = (h ^ (unsigned char)*b) * 1099511628211ull;
+	return h;
+    }
+
+    std::uint32_t find(const char *b, std::size_t n) {
+	const std::uint64_t h = hash(b, n);
+	std::size_t i = std::size_t(h) & (slots.size() - 1);
+	for ( ; slots[i] ; i = (i + 1) & (slots.size() - 1) ) {
+	    const std::uint32_t k = slots[i] - 1;
+	    if ( hashes[k] == h && names[k].size() == n
+		&& !memcmp(names[k].data(), b, n) )
+		return k;
+	}
+	// a new name
+	const std::uint32_t k = std::uint32_t(names.size());
+	names.push_back(std::string(b, n));
+	hashes.push_back(h);
+	slots[i] = k + 1;
+	if ( 2 * names.size() > slots.size() ) { // keep the load under a half
+	    std::vector<std::uint32_t>(2 * slots.size()).swap(slots);
+	    for ( std::uint32_t j = 0 ; j < names.size() ; j++ ) {
+		std::size_t x = std::size_t(hashes[j]) & (slots.size() - 1);
+		while ( slots[x] )
+		    x = (x + 1) & (slots.size() - 1);
+		slots[x] = j + 1;
+	    }
+	}
+	return k;
+    }
+
+public:
+    // id(b, n): the id of the name [b, b + n), numbering it if new
+    std::uint32_t id(const char *b, std::size_t n) {
+	if ( !shared )
+	    return find(b, n);
+	std::lock_guard<std::mutex> lock(m);
+	return find(b, n);
+    }
+
+    std::uint32_t id(const std::string &t) { return id(t.data(), t.size()); }
+
+    // name(i): the name of id i
+    const std::string &name(std::uint32_t i) const {
+	if ( !shared )
+	    return names[i];
+	std::lock_guard<std::mutex> lock(m);
+	return names[i];
+    }
+
+    std::size_t size() const {
+	if ( !shared )
+	    return names.size();
+	std::lock_guard<std::mutex> lock(m);
+	return names.size();
+    }
+
+    explicit symbol_table(bool shared =false) : slots(64), shared(shared) {}
+};
+
+class expected_set; // what the parsers failing furthest expected, defined below
+
+#include <exception> // for std::exception_ptr
+
+// pos_stream derives streambuf and contains an additional Pos object
+class pos_stream : public std::streambuf {
+protected:
+    std::streambuf *const sbuf;
+
+    // accessors to the get area of another streambuf; a pointer to a protected member
+    // can be formed through a derived class and then applied to any streambuf.
+    struct get_area : std::streambuf {
+	static char *begin(std::streambuf *b) { return (b->*&get_area::gptr)(); }
+	static char *end(std::streambuf *b) { return (b->*&get_area::egptr)(); }
+	static void bump(std::streambuf *b, int n) { (b->*&get_area::gbump)(n); }
+    };
+
+    // The istream catches what sbuf throws while reading, setting badbit as a failure
+    // that the combinators would clear; failure keeps it for rethrow_input(s).
+    std::streambuf::int_type underflow() {
+	try {
+	    return sbuf->sgetc();
+	}
+	catch ( ... ) {
+	    failure = std::current_exception();
+	    throw;
+	}
+    }
+
+    std::streambuf::int_type uflow() {
+	try {
+	    const std::streambuf::int_type x = sbuf->sbumpc();
+	    c = char(x);
+	    return x; // not c, as a char of 0xff would read as EOF
+	}
+	catch ( ... ) {
+	    failure = std::current_exception();
+	    throw;
+	}
+    }
+	// Note uflow() is not called for reading out eof.
+
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	// Note istream(not streambuf) implements tellg() as seekoff(0, ios_base::cur).
+	return sbuf->pubseekoff(off, way, which);
+    }
+
+    std::streampos seekpos(std::streampos pos,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	return sbuf->pubseekpos(pos, which);
+    }
+
+public:
+    // Pos keeps track of the current reading position. Parsec in Haskell has every
+    // parser get a pos as an argument and return a pos as a result. However, we here
+    // include into a streambuf the pos that is updated by request, update(); the pos
+    // here gets updated manually to accomodate streambufs that do not enable seekoff()
+    // and seekpos(). For automatic updates, uflow() would take the responsibility of
+    // advancing the pos, and seekoff(), seekpos() and pbackfail() should also take care
+    // of rewinding the pos and besides the case the nested streambuf itself might not
+    // enable seekoff() and seekpos() should be considered.
+    struct Pos {
+	std::streamoff off; // tracks file position like istream::tellg()
+	int row, col; // cursor position
+
+	Pos() : off(0), row(1), col(1) {}
+	// the default functions will do enough
+	//Pos(const Pos &p) : off(p.off), row(p.row), col(p.col) {}
+	//void operator=(const Pos &p) { off = p.off; row = p.row; col = p.col; }
+
+	void update(char c) {
+	    off++;
+	    if ( c == '\t' )
+		col += 8 - (col-1) % 8;
+	    else if ( c == '\n' )
+		row++, col = 1;
+	    else
+		col++;
+	}
+
+	void update(const char *b, const char *e) { // for characters in [b, e)
+	    off += e - b;
+	    for ( const char *n ; (n = (const char *)memchr(b, '\n', e - b)) ; b = n + 1 )
+		row++, col = 1;
+	    if ( !memchr(b, '\t', e - b) )
+		col += int(e - b);
+	    else
+		for ( ; b != e ; b++ )
+		    col += *b == '\t' ? 8 - (col-1) % 8 : 1;
+	}
+    } pos;
+
+    char c; // last character read
+
+    // errors recovered by recover() in the order of occurrence
+    struct Error {
+	Pos pos; // where the error was detected
+	const char *rule; // name of the recovering rule, if given
+	// what was expected, as message() of expected(s) if set, e.g. "expected ';' at
+	// 2:7", for the failures since the previous error
+	std::string expected;
+    };
+    std::vector<Error> errors;
+
+    flat_tree *tree; // where tag() emits nodes, or nullptr not to build a tree
+
+    // limits of a parse, unlimited by default, charged by the combinators that repeat,
+    // branch or backtrack, and by rules applied as s >> p; as the clock is read only
+    // every 1024 steps, the deadline can be overrun by as many steps.
+    struct Budget {
+	std::uint64_t steps; // iterations, alternatives and applications left
+	unsigned depth; // nesting of s >> p left
+	std::uint64_t backtrack; // bytes left for try_() to rewind in total
+	std::chrono::steady_clock::time_point deadline;
+
+	Budget()
+	: steps(std::uint64_t(-1)), depth(unsigned(-1)), backtrack(std::uint64_t(-1)),
+	  deadline(std::chrono::steady_clock::time_point::max()) {}
+
+	void timeout(std::chrono::steady_clock::duration d) {
+	    deadline = std::chrono::steady_clock::now() + d;
+	}
+
+	static void exceeded(const char *limit) {
+	    const BudgetExceeded e = { limit };
+	    throw e;
+	}
+
+	void step() {
+	    if ( !steps )
+		exceeded("steps");
+	    if ( !(--steps & 1023) && std::chrono::steady_clock::now() > deadline )
+		exceeded("time");
+	}
+
+	void rewind(std::streamoff n) {
+	    if ( std::uint64_t(n) > backtrack )
+		exceeded("backtrack");
+	    backtrack -= std::uint64_t(n);
+	}
+
+	// a step one level deeper during the lifetime of nest, if b is given
+	struct nest {
+	    Budget *const b;
+
+	    nest(Budget *b) : b(b) {
+		if ( b ) {
+		    b->step();
+		    if ( !b->depth )
+			exceeded("depth");
+		    b->depth--;
+		}
+	    }
+
+	    ~nest() {
+		if ( b )
+		    b->depth++;
+	    }
+	};
+    };
+    Budget *budget; // limits of the parse, or nullptr for none
+
+    trace_log *trace; // where the events of the parse are recorded, or nullptr for none
+
+    container_pool *pool; // where results are built, or nullptr for new containers
+
+    symbol_table *symbols; // where intern(p) numbers names, or nullptr for none
+
+    expected_set *expected; // where failures note what was expected, or nullptr
+
+    std::exception_ptr failure; // thrown by sbuf while the istream read, if any
+
+    pos_stream(std::streambuf *sbuf)
+    : sbuf(sbuf), tree(nullptr), budget(nullptr), trace(nullptr), pool(nullptr),
+      symbols(nullptr), expected(nullptr) {}
+
+    std::streambuf *nested() const { return sbuf; } // the streambuf read through
+
+    // ahead(n): the next n characters in the get area of sbuf, without consuming them,
+    // or nullptr if the get area holds fewer
+    const char *ahead(std::size_t n) {
+	sbuf->sgetc(); // refill the get area if empty
+	const char *const b = get_area::begin(sbuf);
+	return std::size_t(get_area::end(sbuf) - b) >= n ? b : nullptr;
+    }
+
+    // scan(span, t) consumes the longest prefix of characters accepted by span(b, e),
+    // which returns the end of the accepted prefix of [b, e), and appends the prefix to
+    // *t if t is given. The characters are scanned in bulk over the get area of sbuf, or
+    // one by one if sbuf is unbuffered. Returns the number of characters consumed.
+    // Note scan() works under the istream, as pos_stream itself keeps no get area.
+    template <class F>
+    std::streamsize scan(const F &span, std::string *t =0) {
+	std::streamsize n = 0;
+	while ( sbuf->sgetc() != EOF ) { // refill the get area if empty
+	    const char *const b = get_area::begin(sbuf), *const e = get_area::end(sbuf);
+	    if ( b == e ) { // unbuffered
+		const char x = char(sbuf->sgetc());
+		if ( span(&x, &x + 1) == &x )
+		    break;
+		if ( t )
+		    t->push_back(x);
+		sbuf->sbumpc();
+		pos.update(c = x);
+		n++;
+		continue;
+	    }
+
+	    const char *const m = span(b, e);
+	    if ( m != b ) {
+		if ( t )
+		    t->append(b, m);
+		pos.update(b, m);
+		c = m[-1];
+		get_area::bump(sbuf, int(m - b));
+		n += m - b;
+	    }
+	    if ( m != e )
+		break;
+	}
+	return n;
+    }
+};
+
+// typing savers for static_cast<pos_stream *>(s.rdbuf())
+inline void update_pos(std::istream &s)
+{
+    pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+    ps->pos.update(ps->c);
+}
+
+inline std::streamoff tellg(std::istream &s, std::streamoff since)
+// similar to s.tellg() but also work for istreams that disables it
+{
+    return static_cast<pos_stream *>(s.rdbuf())->pos.off - since;
+}
+
+inline pos_stream::Pos &pos(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->pos;
+}
+
+inline std::vector<pos_stream::Error> &errors(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->errors;
+}
+
+inline flat_tree *&tree(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->tree;
+}
+
+inline pos_stream::Budget *&budget(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->budget;
+}
+
+inline trace_log *&trace(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->trace;
+}
+
+// charge(s): charge a step to the budget of s, if any
+inline void charge(std::istream &s)
+{
+    pos_stream::Budget *const b = budget(s);
+    if ( b )
+	b->step();
+}
+
+// tree_mark(s) and tree_rollback(s, m): the state of tree(s), if set, and its
+// restoration, for a repetition to drop the (empty) nodes of its last iteration that
+// fails weakly
+inline flat_tree::mark tree_mark(std::istream &s)
+{
+    flat_tree *const f = tree(s);
+    return f ? f->tell() : flat_tree::mark();
+}
+
+inline void tree_rollback(std::istream &s, const flat_tree::mark &m)
+{
+    if ( flat_tree *const f = tree(s) )
+	f->rollback(m);
+}
+
+inline container_pool *&pool(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->pool;
+}
+
+inline symbol_table *&symbols(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->symbols;
+}
+
+inline expected_set *&expected(std::istream &s)
+{
+    return static_cast<pos_stream *>(s.rdbuf())->expected;
+}
+
+// pooled<C>(s): an empty C for a result, taken from the pool of s if any
+template <class C>
+inline C pooled(std::istream &s)
+{
+    container_pool *const p = pool(s);
+    return p ? p->take<C>() : C();
+}
+
+// recycle(s, c): give c back to the pool of s if any, when done with it
+template <class C>
+inline void recycle(std::istream &s, C c)
+{
+    if ( container_pool *const p = pool(s) )
+	p->recycle(std::move(c));
+}
+
+// exception for a parsing error
+struct ParserError {};
+
+// exception for an input source failing, such as on corrupt compressed data or on a
+// rewind further back than the source keeps, which is not a ParserError either
+struct InputError {
+    const char *what;
+};
+
+// rethrow_input(s): rethrow what the input source of s threw while the istream read, if
+// it did, e.g. InputError on corrupt data, which the istream caught setting badbit
+inline void rethrow_input(std::istream &s)
+{
+    const std::exception_ptr &f = static_cast<pos_stream *>(s.rdbuf())->failure;
+    if ( f )
+	std::rethrow_exception(f);
+}
+
+// clear_weak(s): clear a weak failure of s to go on, but rethrow_input(s) if s is bad
+// rather than failed, so that a source failing is never taken for a weak failure
+inline void clear_weak(std::istream &s)
+{
+    if ( s.bad() )
+	rethrow_input(s);
+    s.clear();
+}
+
+// seek_back(s, g): rewind s to g from tellg() to backtrack, throwing InputError if the
+// streambuf cannot, e.g. further back than it keeps, as seekg() only sets badbit then
+inline void seek_back(std::istream &s, std::streampos g)
+{
+    clear_weak(s);
+    s.seekg(g);
+    if ( s.bad() ) {
+	const InputError e = { "unable to rewind the input" };
+	throw e;
+    }
+}
+
+// macros to help throwing exceptions
+#define MARK	std::streamoff _off(tellg(s, 0))
+
+#define CHECK \
+    if ( s.fail() && tellg(s, _off) ) \
+	throw ParserError(); \
+    else
+
+#define RETURN(...) \
+    do { \
+	if ( s.fail() && tellg(s, _off) ) \
+	    throw ParserError(); \
+	return __VA_ARGS__; \
+    } while( false )
+    // throw exception only if fail and consume nothing
+    // RETURN(x) equals CHECK; return x;
+
+#define RETURN_IF_FAIL(...) \
+    if ( s.fail() ) { \
+	if ( tellg(s, _off) ) \
+	    throw ParserError(); \
+	return __VA_ARGS__; \
+    } else
+    // throw exception only if fail and consume nothing
+    // RETURN() and RETURN_IF_FAIL() is designed to be close to a statement (though not
+    // a function) that can be nested in another statement.
+
+
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h> // for _mm256_shuffle_epi8(), ...
+#elif defined(__GNUC__) && defined(__SSSE3__)
+#include <tmmintrin.h> // for _mm_shuffle_epi8(), ...
+#endif
+
+// char_class is a set of characters as a 256-bit bitmap. span() finds the end of a run
+// of characters in the set 16 or 32 characters at a time using pshufb if enabled, where
+// each character is looked up by its low nibble in a row of bits indexed by the high
+// nibble (Wojciech Mula, "SIMD-ized faster parse of double quoted strings" and "SIMDized
+// check which bytes are in a set").
+class char_class {
+protected:
+    std::uint64_t bits[4];
+    unsigned char rows[2][16]; // rows[h / 8][l] has bit h % 8 set if (h << 4 | l) is in
+
+public:
+    char_class() { memset(bits, 0, sizeof(bits)); memset(rows, 0, sizeof(rows)); }
+
+    char_class(const char *s) : char_class() { // characters in s
+	while ( *s )
+	    insert(*s++);
+    }
+
+    char_class(char first, char last) : char_class() { // characters in [first, last]
+	for ( int c = (unsigned char)first ; c <= (unsigned char)last ; c++ )
+	    insert(char(c));
+    }
+
+    char_class(int (*f)(int)) : char_class() { // characters satisfying f
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( f(c) )
+		insert(char(c));
+    }
+
+    void insert(char c) {
+	const unsigned char u = c;
+	bits[u >> 6] |= std::uint64_t(1) << (u & 63);
+	rows[u >> 7][u & 15] |= (unsigned char)(1 << (u >> 4 & 7));
+    }
+
+    bool contains(char c) const {
+	return bits[(unsigned char)c >> 6] >> (c & 63) & 1;
+    }
+
+    char_class operator|(const char_class &cc) const {
+	char_class r(*this);
+	for ( int i = 0 ; i < 4 ; i++ )
+	    r.bits[i] |= cc.bits[i];
+	for ( int i = 0 ; i < 16 ; i++ )
+	    r.rows[0][i] |= cc.rows[0][i], r.rows[1][i] |= cc.rows[1][i];
+	return r;
+    }
+
+    char_class operator&(const char_class &cc) const {
+	char_class r;
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( contains(char(c)) && cc.contains(char(c)) )
+		r.insert(char(c));
+	return r;
+    }
+
+    char_class operator~() const {
+	char_class r;
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( !contains(char(c)) )
+		r.insert(char(c));
+	return r;
+    }
+
+    bool empty() const { return !(bits[0] | bits[1] | bits[2] | bits[3]); }
+
+    // span(b, e): the end of the run of characters in the set from b
+    const char *span(const char *b, const char *e) const {
+	for ( const char *const m = e - b > 8 ? b + 8 : e ; b != m ; b++ )
+	    if ( !contains(*b) ) // a short run, such as most tokens, before going wide
+		return b;
+#if defined(__GNUC__) && defined(__AVX2__)
+	const __m256i row0 =
+	    _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)rows[0]));
+	const __m256i row1 =
+	    _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)rows[1]));
+	const __m256i bit = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+	    1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+	    1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i nibble = _mm256_set1_epi8(0x0f), eight = _mm256_set1_epi8(8);
+	for ( ; e - b >= 32 ; b += 32 ) {
+	    const __m256i x = _mm256_loadu_si256((const __m256i *)b);
+	    const __m256i lo = _mm256_and_si256(x, nibble);
+	    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+	    const __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(row1, lo),
+		_mm256_shuffle_epi8(row0, lo), _mm256_cmpgt_epi8(eight, hi));
+	    const __m256i mask = _mm256_shuffle_epi8(bit, hi);
+	    const unsigned in = unsigned(_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(_mm256_and_si256(row, mask), mask)));
+	    if ( ~in )
+		return b + __builtin_ctz(~in);
+	}
+#elif defined(__GNUC__) && defined(__SSSE3__)
+	const __m128i row0 = _mm_loadu_si128((const __m128i *)rows[0]);
+	const __m128i row1 = _mm_loadu_si128((const __m128i *)rows[1]);
+	const __m128i bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+	    1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i nibble = _mm_set1_epi8(0x0f), eight = _mm_set1_epi8(8);
+	for ( ; e - b >= 16 ; b += 16 ) {
+	    const __m128i x = _mm_loadu_si128((const __m128i *)b);
+	    const __m128i lo = _mm_and_si128(x, nibble);
+	    const __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), nibble);
+	    const __m128i low = _mm_cmplt_epi8(hi, eight);
+	    const __m128i row = _mm_or_si128(
+		_mm_and_si128(low, _mm_shuffle_epi8(row0, lo)),
+		_mm_andnot_si128(low, _mm_shuffle_epi8(row1, lo)));
+	    const __m128i mask = _mm_shuffle_epi8(bit, hi);
+	    const unsigned in = unsigned(_mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_and_si128(row, mask), mask)));
+	    if ( in != 0xffff )
+		return b + __builtin_ctz(~in);
+	}
+#endif
+	while ( b != e && contains(*b) )
+	    b++;
+	return b;
+    }
+
+    // for pos_stream::scan()
+    const char *operator()(const char *b, const char *e) const { return span(b, e); }
+};
+
+
+
+/* // for supporting function parsers that are not so useful as parsing functions
+template <typename T, typename U =void>
+// parser of type T(U)
+class parser {
+public:
+    virtual T operator()(std::istream &, U) const =0; // a parser is just a function
+    virtual ~parser() {}
+};
+
+template <typename T>
+// T is the result type(a parse tree normally) of parser
+class parser<T, void> {
+public:
+    virtual T operator()(std::istream &) const =0; // a parser is just a function
+    virtual ~parser() {}
+};
+*/
+
+#include <typeinfo> // for std::type_info
+
+// parser_base is the untyped part of every parser, which lets the combinator graph be
+// walked for analyzing or compiling it.
+class parser_base {
+public:
+    // node describes how a parser combines its operands p and q
+    struct node {
+	enum kind_t {
+	    OPAQUE, // not described
+	    MATCH, // character parser matching cc
+	    STR, // skip(s)
+	    END, // eof()
+	    SPAN, // take_while(cc), take_while1(cc) if min is 1, skip_while(cc)
+	    SKIP, // skip(p)
+	    MAP, // p >> f; action is false if f only converts a char to a string
+	    CHAIN, // p >> f for a parsing function f
+	    CAT, // p + q
+	    SEQ, // p > q
+	    MANY, // many(p)
+	    MANY1, // many1(p)
+	    SEP_BY, // sep_by(p, q)
+	    SEP_BY1, // sep_by1(p, q)
+	    ALT, // p | q
+	    TRY // try_(p)
+	} kind;
+	const parser_base *p, *q;
+	char_class cc;
+	const char *s;
+	int min;
+	bool action;
+
+	node(kind_t kind, const parser_base *p =0, const parser_base *q =0)
+	: kind(kind), p(p), q(q), s(0), min(0), action(true) {}
+    };
+
+    virtual node describe() const { return node(node::OPAQUE); }
+    virtual const std::type_info &result_type() const =0;
+    virtual ~parser_base() {}
+};
+
+typedef parser_base::node parser_node;
+
+template <typename T>
+// T is the result type(a parse tree normally) of parser
+class parser : public parser_base {
+public:
+    virtual T operator()(std::istream &) const =0; // a parser is just a function
+    const std::type_info &result_type() const override { return typeid(T); }
+    virtual ~parser() {}
+};
+
+// cin >> p: apply a parser to an istream
+template <typename T>
+inline T operator>>(std::istream &s, const std::shared_ptr<parser<T>> &p)
+{
+    // p is declared of a const reference type not to affect its memory allocation
+    const pos_stream::Budget::nest n(budget(s)); // for rules applied recursively
+    T t(p->operator()(s));
+    if ( s.bad() )
+	rethrow_input(s);
+    return t;
+}
+
+template <> // function template specialization
+inline void operator>>(std::istream &s, const std::shared_ptr<parser<void>> &p)
+{
+    const pos_stream::Budget::nest n(budget(s));
+    p->operator()(s);
+    if ( s.bad() )
+	rethrow_input(s);
+}
+
+/* // provided in C++ by default??
+// cin >> f for a parsing function f
+template <typename T>
+inline T operator>>(std::istream &s, T (*f)(std::istream &))
+{
+    return f(s);
+}
+*/
+
+
+
+#include <unordered_map> // for std::unordered_map
+#include <mutex> // for std::mutex
+
+// share_key(p): the identity of p as its class and what it describe()s, with operands
+// compared by address, or "" if p does not describe all of its operands (e.g. callables)
+inline std::string share_key(const parser_base &p)
+{
+    const parser_node n = p.describe();
+    if ( n.kind == parser_node::OPAQUE || n.kind == parser_node::MAP
+	|| n.kind == parser_node::CHAIN
+	|| ((n.kind == parser_node::MANY1 || n.kind == parser_node::SEP_BY1)
+	    && p.result_type() != typeid(void)) ) // with a combiner f
+	return std::string();
+
+    std::string k(typeid(p).name());
+    k.push_back('\0');
+    k.push_back(char(n.kind));
+    k.append((const char *)&n.p, sizeof(n.p));
+    k.append((const char *)&n.q, sizeof(n.q));
+    for ( int c = 0 ; c < 256 ; c += 8 ) {
+	char b = 0;
+	for ( int i = 0 ; i < 8 ; i++ )
+	    b |= char(n.cc.contains(char(c + i)) << i);
+	k.push_back(b);
+    }
+    k.push_back(char(n.min));
+    if ( n.s )
+	k.append(n.s);
+    return k;
+}
+
+// share(p): the parser identical to p that was shared before and is still alive, or p
+// itself, to be returned for later identical ones. As parsers are immutable once built,
+// a grammar needs only one instance of each distinct node, which the factories of the
+// library share this way except for those with callables; sharing works bottom-up, as
+// operands are compared by address.
+template <typename T>
+inline std::shared_ptr<parser<T>> share(std::shared_ptr<parser<T>> p)
+{
+    const std::string k = share_key(*p);
+    if ( k.empty() )
+	return p;
+
+    static std::mutex m;
+    static std::unordered_map<std::string, std::weak_ptr<parser_base>> table;
+    static std::size_t sweep = 64; // table size to drop dead entries at
+    std::lock_guard<std::mutex> lock(m);
+    std::weak_ptr<parser_base> &w = table[k];
+    if ( const std::shared_ptr<parser_base> q = w.lock() )
+	return std::static_pointer_cast<parser<T>>(q); // of the same class as p
+    w = p;
+    if ( table.size() >= sweep ) {
+	for ( auto i = table.begin() ; i != table.end() ; )
+	    i = i->second.expired() ? table.erase(i) : std::next(i);
+	sweep = 2 * table.size() + 64;
+    }
+    return p;
+}
+
+
+
+// expected_set tracks the furthest position where a parser failed and the parsers that
+// failed there, so that a failed parse can tell what was expected where without being
+// parsed again. Noting a failure costs a comparison of offsets and at most a push of a
+// pointer, as the characters and literals expected are worked out from the parsers
+// only when asked for, which must then be alive.
+class expected_set {
+public:
+    pos_stream::Pos pos; // of the furthest failure
+    std::vector<const parser_base *> parsers; // that failed at pos, empty if none
+
+    // fail(at, p): note that p failed at at, forgetting the failures before it
+    void fail(const pos_stream::Pos &at, const parser_base *p) {
+	if ( !parsers.empty() && at.off < pos.off )
+	    return;
+	if ( parsers.empty() || at.off > pos.off )
+	    pos = at, parsers.clear(); // keeping the capacity
+	for ( const parser_base *q : parsers )
+	    if ( q == p )
+		return;
+	if ( parsers.size() < 16 )
+	    parsers.push_back(p);
+    }
+
+    void reset() { pos = pos_stream::Pos(), parsers.clear(); }
+
+    char_class chars() const; // the characters expected at pos
+    std::vector<std::string> literals() const; // the literals expected at pos
+    bool end() const; // whether the end of input was expected at pos
+
+    // message(): e.g. "expected '0'-'9', '[' or '{' at 3:5", or "" if
+    // nothing has failed
+    std::string message() const;
+};
+
+// expect(s, p): note that p failed at the position of s into expected(s), if set
+inline void expect(std::istream &s, const parser_base *p)
+{
+    if ( expected_set *const e = expected(s) )
+	e->fail(pos(s), p);
+}
+
+
+
+// abstract character-matching parser
+class parser_match : public parser<char> {
+protected:
+    virtual bool match(char) const =0;
+
+public:
+    // the set of characters to match
+    virtual char_class chars() const {
+	char_class cc;
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( match(char(c)) )
+		cc.insert(char(c));
+	return cc;
+    }
+
+    parser_node describe() const override {
+	parser_node n(parser_node::MATCH);
+	n.cc = chars();
+	return n;
+    }
+
+    char operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    // Note fail() == failbit | badbit and failbit is independent of the eofbit.
+	    throw ParserError(); // expecting 'c'
+
+	const char c = s.peek();
+	if ( match(c) ) { // may possibly set eofbit
+	    s.ignore(); // consume 'c'
+	    update_pos(s);
+	    return c;
+	}
+
+	s.setstate(std::ios::failbit); // mark failure
+	expect(s, this);
+	return char(); // return 0 if not matched
+    }
+
+    virtual ~parser_match() {}
+};
+
+
+
+class parser_chr : public parser_match {
+protected:
+    const char c;
+    bool match(char c) const override { return c == parser_chr::c; }
+
+public:
+    parser_chr(char c) : c(c) {}
+};
+
+// chr('c'): character-matching parser
+inline std::shared_ptr<parser<char>> chr(char c)
+{
+    return share(std::shared_ptr<parser<char>>(new parser_chr(c)));
+}
+
+
+
+class parser_any_char : public parser_match {
+protected:
+    bool match(char) const override { return true; }
+
+public:
+    parser_any_char() {}
+};
+
+// any_chr(): /./
+inline std::shared_ptr<parser<char>> any_chr()
+{
+    return share(std::shared_ptr<parser<char>>(new parser_any_char()));
+}
+
+
+
+#include <cstring> // for strchr()
+
+class parser_one_of : public parser_match {
+protected:
+    const char *const s;
+    bool match(char c) const override { return strchr(s, c); }
+
+public:
+    parser_one_of(const char *s) : s(s) {}
+};
+
+// one_of("abc"): /[abc]/
+inline std::shared_ptr<parser<char>> one_of(const char *s)
+{
+    return share(std::shared_ptr<parser<char>>(new parser_one_of(s)));
+}
+
+
+
+class parser_none_of : public parser_match {
+protected:
+    const char *const s;
+    bool match(char c) const override { return !strchr(s, c); }
+
+public:
+    parser_none_of(const char *s) : s(s) {}
+};
+
+// none_of("abc"): /[^abc]/
+inline std::shared_ptr<parser<char>> none_of(const char *s)
+{
+    return share(std::shared_ptr<parser<char>>(new parser_none_of(s)));
+}
+
+// blank(): /[ \t]/
+inline std::shared_ptr<parser<char>> blank() { return one_of(" \t"); }
+    // could use isblank() if in C++11
+
+
+
+#include <cctype> // for isalpha(), isalnum(), isdigit()
+
+class parser_fmatch : public parser_match {
+protected:
+    int (*const f)(int);
+    bool match(char c) const override { return f(c); }
+
+public:
+    parser_fmatch(int (*f)(int)) : f(f) {}
+};
+
+// letter()
+inline std::shared_ptr<parser<char>> letter()
+{
+    return share(std::shared_ptr<parser<char>>(new parser_fmatch(isalpha)));
+}
+
+// alphanum()
+inline std::shared_ptr<parser<char>> alphanum()
+{
+    return share(std::shared_ptr<parser<char>>(new parser_fmatch(isalnum)));
+}
+
+// digit()
+inline std::shared_ptr<parser<char>> digit()
+{
+    return share(std::shared_ptr<parser<char>>(new parser_fmatch(isdigit)));
+}
+
+
+
+// span parsers consume a whole run of characters in a char_class at once through
+// pos_stream::scan(), rather than calling a character parser for each character.
+class parser_take_while : public parser<std::string> {
+protected:
+    const char_class cc;
+    const bool one; // at least one character required
+
+public:
+    std::string operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting cc
+
+	std::string t(pooled<std::string>(s));
+	if ( !static_cast<pos_stream *>(s.rdbuf())->scan(cc, &t) && one ) {
+	    s.setstate(std::ios::failbit); // mark failure
+	    expect(s, this);
+	}
+	return t;
+    }
+
+    parser_node describe() const override {
+	parser_node n(parser_node::SPAN);
+	n.cc = cc, n.min = one;
+	return n;
+    }
+
+    parser_take_while(const char_class &cc, bool one) : cc(cc), one(one) {}
+};
+
+// take_while(cc): /[cc]*/
+inline std::shared_ptr<parser<std::string>> take_while(const char_class &cc)
+{
+    return share(std::shared_ptr<parser<std::string>>(new parser_take_while(cc, false)));
+}
+
+// take_while1(cc): /[cc]+/
+inline std::shared_ptr<parser<std::string>> take_while1(const char_class &cc)
+{
+    return share(std::shared_ptr<parser<std::string>>(new parser_take_while(cc, true)));
+}
+
+class parser_skip_while : public parser<void> {
+protected:
+    const char_class cc;
+
+public:
+    void operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting cc
+
+	static_cast<pos_stream *>(s.rdbuf())->scan(cc);
+    }
+
+    parser_node describe() const override {
+	parser_node n(parser_node::SPAN);
+	n.cc = cc;
+	return n;
+    }
+
+    parser_skip_while(const char_class &cc) : cc(cc) {}
+};
+
+// skip_while(cc): optional void parser consuming /[cc]*/
+inline std::shared_ptr<parser<void>> skip_while(const char_class &cc)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_skip_while(cc)));
+}
+
+
+
+
+class parser_str : public parser<void> {
+protected:
+    const char *const s;
+
+public:
+    void operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting s
+
+	MARK;
+	const pos_stream::Pos at = pos(s); // where the literal was expected
+	for ( const char *t = parser_str::s ; *t ; t++ )
+	    if ( s.peek() == *t ) {
+		s.ignore(); // consume *t
+		update_pos(s);
+	    }
+	    else {
+		s.setstate(std::ios::failbit);
+		if ( expected_set *const e = expected(s) )
+		    e->fail(at, this);
+		RETURN(); // result in "weak failure" or "error failure"
+		    // redundant to check for s.fail() within RETURN()
+	    }
+	// do nothing if parser_str::s is empty
+    }
+
+    parser_node describe() const override {
+	parser_node n(parser_node::STR);
+	n.s = s;
+	return n;
+    }
+
+    parser_str(const char *s) : s(s) {}
+};
+
+// skip("abc"): string-matching void parser
+// skip("abc") equals "skip('a') >> skip('b') >> skip('c')"
+inline std::shared_ptr<parser<void>> skip(const char *s)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_str(s)));
+}
+
+
+
+// for pos_stream::scan(), spanning up to the first occurrence of c using memchr(), which
+// is vectorized in most C libraries
+struct span_until_chr {
+    const char c;
+    const char *operator()(const char *b, const char *e) const {
+	const char *const m = (const char *)memchr(b, c, e - b);
+	return m ? m : e;
+    }
+};
+
+class parser_scan_until : public parser<std::string> {
+protected:
+    const char *const d; // delimiter
+    std::vector<std::size_t> border; // border[j]: longest proper border of d[0..j)
+    const std::shared_ptr<parser<void>> delim; // noted as expected at eof
+
+public:
+    std::string operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting d
+
+	MARK;
+	std::string t(pooled<std::string>(s));
+	for ( std::size_t j = 0 ; d[j] ; ) { // j characters of d are matched
+	    if ( j == 0 ) // jump to the next candidate for d in bulk
+		static_cast<pos_stream *>(s.rdbuf())->scan(span_until_chr{d[0]}, &t);
+
+	    const int c = s.peek();
+	    if ( c == EOF ) {
+		s.setstate(std::ios::failbit);
+		expect(s, delim.get());
+		RETURN(std::string()); // result in "weak failure" or "error failure"
+	    }
+	    s.ignore(); // consume c
+	    update_pos(s);
+
+	    // step the matcher by Knuth-Morris-Pratt, moving the characters that can no
+	    // longer start d into the result; compared as chars, as c is not EOF
+	    const char x = char(c);
+	    while ( j && d[j] != x ) {
+		t.append(d, j - border[j]);
+		j = border[j];
+	    }
+	    if ( d[j] == x )
+		j++;
+	    else
+		t.push_back(x);
+	}
+	return t;
+    }
+
+    parser_scan_until(const char *d)
+    : d(d), border(strlen(d) + 1), delim(new parser_str( d )) {
+	for ( std::size_t j = 2 ; j < border.size() ; j++ ) {
+	    std::size_t k = border[j-1];
+	    while ( k && d[k] != d[j-1] )
+		k = border[k];
+	    border[j] = d[k] == d[j-1] ? k + 1 : 0;
+	}
+    }
+};
+
+// scan_until("*/"): parse /.*?\*\// and return the characters before the delimiter; the
+// delimiter is consumed but not returned, and is not copied (as in skip("abc")).
+inline std::shared_ptr<parser<std::string>> scan_until(const char *d)
+{
+    return std::shared_ptr<parser<std::string>>(new parser_scan_until(d));
+}
+
+class parser_quoted : public parser<std::string> {
+protected:
+    const char q; // quote
+    const char e; // escape, which can also be the same as q for doubling the quote
+    char (*const f)(char); // to translate the escaped character
+    char_class body; // characters other than q and e
+    const std::shared_ptr<parser<char>> quote, escaped; // noted as expected
+
+public:
+    std::string operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting q
+
+	MARK;
+	const int qi = (unsigned char)q, ei = (unsigned char)e; // as peek() returns them
+	if ( s.peek() != qi ) {
+	    s.setstate(std::ios::failbit);
+	    expect(s, quote.get());
+	    return std::string(); // "weak failure"
+	}
+	s.ignore(); // consume q
+	update_pos(s);
+
+	std::string t(pooled<std::string>(s));
+	for ( ;; ) {
+	    static_cast<pos_stream *>(s.rdbuf())->scan(body, &t);
+
+	    int c = s.peek();
+	    if ( c == EOF ) {
+		s.setstate(std::ios::failbit);
+		expect(s, quote.get());
+		RETURN(std::string()); // "error failure" since q is consumed
+	    }
+	    s.ignore(); // consume q or e
+	    update_pos(s);
+
+	    if ( c == qi && (ei != qi || s.peek() != qi) )
+		return t;
+
+	    // escape, resolved only where it occurs
+	    if ( (c = s.peek()) == EOF ) {
+		s.setstate(std::ios::failbit);
+		expect(s, escaped.get());
+		RETURN(std::string());
+	    }
+	    s.ignore(); // consume the escaped character
+	    update_pos(s);
+	    t.push_back(f ? f(char(c)) : char(c));
+	}
+    }
+
+    parser_quoted(char q, char e, char (*f)(char))
+    : q(q), e(e), f(f), body(), quote(chr(q)), escaped(any_chr()) {
+	body.insert(q);
+	body.insert(e);
+	body = ~body;
+    }
+};
+
+// quoted('"', '\\'): parse a literal quoted by '"' and return its body, in which '\\'
+// escapes the next character; f, if given, translates the escaped character as in
+// unescape_c. e can be the same as q for SQL-style doubled quotes ('' in 'it''s').
+inline std::shared_ptr<parser<std::string>> quoted(char q, char e, char (*f)(char) =0)
+{
+    return std::shared_ptr<parser<std::string>>(new parser_quoted(q, e, f));
+}
+
+// quoted('\''): parse a literal quoted by '\'' where a doubled '\'' stands for itself
+inline std::shared_ptr<parser<std::string>> quoted(char q) { return quoted(q, q); }
+
+// translation of C escape sequences for quoted()
+inline char unescape_c(char c)
+{
+    switch ( c ) {
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'v': return '\v';
+    case '0': return '\0';
+    default: return c;
+    }
+}
+
+
+
+#include <algorithm> // for std::upper_bound()
+#include <utility> // for std::pair
+
+// utf8_decode(b, e, c): decode the UTF-8 sequence at b (< e) into c, and return the end
+// of the sequence, b if malformed (overlong, surrogate, beyond U+10FFFF or a bad
+// continuation byte), or nullptr if cut off by e
+inline const char *utf8_decode(const char *b, const char *e, char32_t &c)
+{
+    const unsigned char *const u = (const unsigned char *)b;
+    unsigned lo = 0x80, hi = 0xbf; // range of the second byte
+    int n; // number of continuation bytes
+    if ( u[0] < 0x80 )
+	return c = u[0], b + 1;
+    else if ( u[0] < 0xc2 )
+	return b; // continuation byte or overlong
+    else if ( u[0] < 0xe0 )
+	n = 1, c = u[0] & 0x1f;
+    else if ( u[0] < 0xf0 ) {
+	n = 2, c = u[0] & 0x0f;
+	if ( u[0] == 0xe0 )
+	    lo = 0xa0; // overlong
+	else if ( u[0] == 0xed )
+	    hi = 0x9f; // surrogate
+    }
+    else if ( u[0] < 0xf5 ) {
+	n = 3, c = u[0] & 0x07;
+	if ( u[0] == 0xf0 )
+	    lo = 0x90; // overlong
+	else if ( u[0] == 0xf4 )
+	    hi = 0x8f; // beyond U+10FFFF
+    }
+    else
+	return b;
+
+    for ( int i = 1 ; i <= n ; i++, lo = 0x80, hi = 0xbf ) {
+	if ( b + i == e )
+	    return nullptr;
+	if ( u[i] < lo || u[i] > hi )
+	    return b;
+	c = c << 6 | (u[i] & 0x3f);
+    }
+    return b + n + 1;
+}
+
+// utf8_encode(c): UTF-8 sequence of c
+inline std::string utf8_encode(char32_t c)
+{
+    std::string t;
+    if ( c < 0x80 )
+	t.push_back(char(c));
+    else if ( c < 0x800 )
+	t.push_back(char(0xc0 | c >> 6)), t.push_back(char(0x80 | (c & 0x3f)));
+    else if ( c < 0x10000 ) {
+	t.push_back(char(0xe0 | c >> 12));
+	t.push_back(char(0x80 | (c >> 6 & 0x3f))), t.push_back(char(0x80 | (c & 0x3f)));
+    }
+    else {
+	t.push_back(char(0xf0 | c >> 18)), t.push_back(char(0x80 | (c >> 12 & 0x3f)));
+	t.push_back(char(0x80 | (c >> 6 & 0x3f))), t.push_back(char(0x80 | (c & 0x3f)));
+    }
+    return t;
+}
+
+// utf8_valid(b, e): the end of the longest prefix of [b, e) made of whole valid UTF-8
+// sequences. With SSSE3, 16 bytes are checked at a time by looking up the high and low
+// nibbles of each byte and the high nibble of the next one with pshufb (John Keiser and
+// Daniel Lemire, "Validating UTF-8 in less than one instruction per byte"), and only
+// the block with an error is revisited one sequence at a time to locate it.
+inline const char *utf8_valid(const char *b, const char *e)
+{
+#if defined(__GNUC__) && defined(__SSSE3__)
+    const char *const begin = b;
+    enum : unsigned char { // error classes of two consecutive bytes
+	TOO_SHORT = 1 << 0, // 11______ 0_______ or 11______ 11______
+	TOO_LONG = 1 << 1, // 0_______ 10______
+	OVERLONG_3 = 1 << 2, // 11100000 100_____
+	TOO_LARGE = 1 << 3, // 11110100 1001____, 11110100 101_____, ...
+	SURROGATE = 1 << 4, // 11101101 101_____
+	OVERLONG_2 = 1 << 5, // 1100000_ 10______
+	TOO_LARGE_1000 = 1 << 6, // 11110101 1000____, 1111011_ 1000____, ...
+	OVERLONG_4 = 1 << 6, // 11110000 1000____
+	TWO_CONTS = 1 << 7, // 10______ 10______
+	CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+    };
+    const __m128i byte_1_high = _mm_setr_epi8(
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	char(TWO_CONTS), char(TWO_CONTS), char(TWO_CONTS), char(TWO_CONTS),
+	TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const char large = char(CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m128i byte_1_low = _mm_setr_epi8(
+	char(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4), char(CARRY | OVERLONG_2),
+	char(CARRY), char(CARRY), char(CARRY | TOO_LARGE), large, large, large,
+	large, large, large, large, large, char(large | SURROGATE), large, large);
+    const char cont = char(TOO_LONG | OVERLONG_2 | TWO_CONTS); // 10______ as byte 2
+    const __m128i byte_2_high = _mm_setr_epi8(
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	char(cont | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+	char(cont | OVERLONG_3 | TOO_LARGE),
+	char(cont | SURROGATE | TOO_LARGE), char(cont | SURROGATE | TOO_LARGE),
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    const __m128i nibble = _mm_set1_epi8(0x0f), zero = _mm_setzero_si128();
+    // a lead byte in the last 3 bytes of a block whose sequence continues to the next
+    const __m128i incomplete = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, char(0xf0 - 1), char(0xe0 - 1), char(0xc0 - 1));
+    __m128i prev = zero, prev_incomplete = zero;
+    for ( ; e - b >= 16 ; b += 16 ) {
+	const __m128i x = _mm_loadu_si128((const __m128i *)b);
+	__m128i error = prev_incomplete;
+	if ( _mm_movemask_epi8(x) ) { // not all ascii
+	    const __m128i prev1 = _mm_alignr_epi8(x, prev, 15);
+	    const __m128i special = _mm_and_si128(_mm_and_si128(
+		_mm_shuffle_epi8(byte_1_high,
+		    _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+		_mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+		_mm_shuffle_epi8(byte_2_high,
+		    _mm_and_si128(_mm_srli_epi16(x, 4), nibble)));
+	    // the third and fourth bytes must be continuations as well
+	    const __m128i must23 = _mm_or_si128(
+		_mm_subs_epu8(_mm_alignr_epi8(x, prev, 14), _mm_set1_epi8(0xe0 - 0x80)),
+		_mm_subs_epu8(_mm_alignr_epi8(x, prev, 13), _mm_set1_epi8(0xf0 - 0x80)));
+	    error = _mm_xor_si128(
+		_mm_and_si128(must23, _mm_set1_epi8(char(0x80))), special);
+	}
+	if ( _mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff )
+	    break; // locate the error below
+	prev = x;
+	prev_incomplete = _mm_subs_epu8(x, incomplete);
+    }
+    // resume at the beginning of the sequence running into b if any, as the blocks before
+    // b are valid but may end with a lead byte whose sequence is cut off
+    for ( int k = 1 ; k <= 3 && b - k >= begin ; k++ ) {
+	const unsigned char u = (unsigned char)b[-k];
+	if ( u >= 0xc0 ) {
+	    if ( (u >= 0xf0 ? 4 : u >= 0xe0 ? 3 : 2) > k )
+		b -= k;
+	    break;
+	}
+	if ( u < 0x80 )
+	    break;
+    }
+#endif
+    for ( char32_t c ; b != e ; ) {
+	const char *const n = utf8_decode(b, e, c);
+	if ( !n || n == b )
+	    break;
+	b = n;
+    }
+    return b;
+}
+
+// utf8_class is a set of code points as a char_class of the ascii members, scanned in
+// bulk by take_while(), and sorted disjoint ranges of the others, looked up by binary
+// search; XID_Start and XID_Continue take a few hundred ranges each.
+class utf8_class {
+protected:
+    char_class ascii; // members below 0x80
+    char_class lead; // lead bytes of the members above 0x7f
+    std::vector<std::pair<char32_t, char32_t>> r; // ranges above 0x7f
+
+    void insert(char32_t first, char32_t last) { // in order and not overlapping
+	if ( first < 0x80 ) {
+	    for ( char32_t c = first ; c <= last && c < 0x80 ; c++ )
+		ascii.insert(char(c));
+	    if ( last < 0x80 )
+		return;
+	    first = 0x80;
+	}
+	r.push_back(std::make_pair(first, last));
+	// lead bytes are in the same order as code points
+	const unsigned char f = (unsigned char)utf8_encode(first)[0];
+	const unsigned char l = (unsigned char)utf8_encode(last)[0];
+	for ( unsigned x = f ; x <= l ; x++ )
+	    lead.insert(char(x));
+    }
+
+public:
+    utf8_class() {}
+
+    utf8_class(const char_class &cc) { // ascii characters in cc
+	for ( int c = 0 ; c < 0x80 ; c++ )
+	    if ( cc.contains(char(c)) )
+		ascii.insert(char(c));
+    }
+
+    utf8_class(char32_t first, char32_t last) { insert(first, last); }
+
+    // code points in cc and in the n sorted disjoint ranges of {first, last, ...}
+    utf8_class(const char_class &cc, const char32_t *ranges, std::size_t n)
+    : utf8_class(cc) {
+	r.reserve(n);
+	for ( std::size_t i = 0 ; i < n ; i++ )
+	    insert(ranges[2*i], ranges[2*i + 1]);
+    }
+
+    bool contains(char32_t c) const {
+	if ( c < 0x80 )
+	    return ascii.contains(char(c));
+	const std::vector<std::pair<char32_t, char32_t>>::const_iterator i =
+	    std::upper_bound(r.begin(), r.end(), std::make_pair(c, char32_t(-1)));
+	return i != r.begin() && c <= i[-1].second;
+    }
+
+    // whether a member may start with the byte c
+    bool starts(char c) const { return ascii.contains(c) || lead.contains(c); }
+
+    utf8_class operator|(const utf8_class &cc) const {
+	utf8_class u;
+	u.ascii = ascii | cc.ascii;
+	std::vector<std::pair<char32_t, char32_t>> a(r);
+	a.insert(a.end(), cc.r.begin(), cc.r.end());
+	std::sort(a.begin(), a.end());
+	for ( std::size_t i = 0 ; i < a.size() ; i++ )
+	    if ( !u.r.empty() && a[i].first <= u.r.back().second + 1 ) {
+		if ( a[i].second > u.r.back().second )
+		    u.r.back().second = a[i].second;
+	    }
+	    else
+		u.r.push_back(a[i]);
+	u.lead = lead | cc.lead;
+	return u;
+    }
+
+    // span(b, e): the end of the run of whole sequences of members from b, where the
+    // ascii members are scanned by char_class::span()
+    const char *span(const char *b, const char *e) const {
+	for ( char32_t c ; (b = ascii.span(b, e)) != e ; ) {
+	    const char *const n = utf8_decode(b, e, c);
+	    if ( !n || n == b || !contains(c) )
+		break;
+	    b = n;
+	}
+	return b;
+    }
+
+    // for pos_stream::scan()
+    const char *operator()(const char *b, const char *e) const { return span(b, e); }
+};
+
+// xid_start(): code points that can start an identifier, or Unicode XID_Start (14.0)
+inline const utf8_class &xid_start()
+{
+    static const char32_t ranges[] = {
+	0xaa,0xaa, 0xb5,0xb5, 0xba,0xba, 0xc0,0xd6, 0xd8,0xf6, 0xf8,0x2c1, 0x2c6,0x2d1,
+	0x2e0,0x2e4, 0x2ec,0x2ec, 0x2ee,0x2ee, 0x370,0x374, 0x376,0x377, 0x37b,0x37d,
+	0x37f,0x37f, 0x386,0x386, 0x388,0x38a, 0x38c,0x38c, 0x38e,0x3a1, 0x3a3,0x3f5,
+	0x3f7,0x481, 0x48a,0x52f, 0x531,0x556, 0x559,0x559, 0x560,0x588, 0x5d0,0x5ea,
+	0x5ef,0x5f2, 0x620,0x64a, 0x66e,0x66f, 0x671,0x6d3, 0x6d5,0x6d5, 0x6e5,0x6e6,
+	0x6ee,0x6ef, 0x6fa,0x6fc, 0x6ff,0x6ff, 0x710,0x710, 0x712,0x72f, 0x74d,0x7a5,
+	0x7b1,0x7b1, 0x7ca,0x7ea, 0x7f4,0x7f5, 0x7fa,0x7fa, 0x800,0x815, 0x81a,0x81a,
+	0x824,0x824, 0x828,0x828, 0x840,0x858, 0x860,0x86a, 0x870,0x887, 0x889,0x88e,
+	0x8a0,0x8c9, 0x904,0x939, 0x93d,0x93d, 0x950,0x950, 0x958,0x961, 0x971,0x980,
+	0x985,0x98c, 0x98f,0x990, 0x993,0x9a8, 0x9aa,0x9b0, 0x9b2,0x9b2, 0x9b6,0x9b9,
+	0x9bd,0x9bd, 0x9ce,0x9ce, 0x9dc,0x9dd, 0x9df,0x9e1, 0x9f0,0x9f1, 0x9fc,0x9fc,
+	0xa05,0xa0a, 0xa0f,0xa10, 0xa13,0xa28, 0xa2a,0xa30, 0xa32,0xa33, 0xa35,0xa36,
+	0xa38,0xa39, 0xa59,0xa5c, 0xa5e,0xa5e, 0xa72,0xa74, 0xa85,0xa8d, 0xa8f,0xa91,
+	0xa93,0xaa8, 0xaaa,0xab0, 0xab2,0xab3, 0xab5,0xab9, 0xabd,0xabd, 0xad0,0xad0,
+	0xae0,0xae1, 0xaf9,0xaf9, 0xb05,0xb0c, 0xb0f,0xb10, 0xb13,0xb28, 0xb2a,0xb30,
+	0xb32,0xb33, 0xb35,0xb39, 0xb3d,0xb3d, 0xb5c,0xb5d, 0xb5f,0xb61, 0xb71,0xb71,
+	0xb83,0xb83, 0xb85,0xb8a, 0xb8e,0xb90, 0xb92,0xb95, 0xb99,0xb9a, 0xb9c,0xb9c,
+	0xb9e,0xb9f, 0xba3,0xba4, 0xba8,0xbaa, 0xbae,0xbb9, 0xbd0,0xbd0, 0xc05,0xc0c,
+	0xc0e,0xc10, 0xc12,0xc28, 0xc2a,0xc39, 0xc3d,0xc3d, 0xc58,0xc5a, 0xc5d,0xc5d,
+	0xc60,0xc61, 0xc80,0xc80, 0xc85,0xc8c, 0xc8e,0xc90, 0xc92,0xca8, 0xcaa,0xcb3,
+	0xcb5,0xcb9, 0xcbd,0xcbd, 0xcdd,0xcde, 0xce0,0xce1, 0xcf1,0xcf2, 0xd04,0xd0c,
+	0xd0e,0xd10, 0xd12,0xd3a, 0xd3d,0xd3d, 0xd4e,0xd4e, 0xd54,0xd56, 0xd5f,0xd61,
+	0xd7a,0xd7f, 0xd85,0xd96, 0xd9a,0xdb1, 0xdb3,0xdbb, 0xdbd,0xdbd, 0xdc0,0xdc6,
+	0xe01,0xe30, 0xe32,0xe32, 0xe40,0xe46, 0xe81,0xe82, 0xe84,0xe84, 0xe86,0xe8a,
+	0xe8c,0xea3, 0xea5,0xea5, 0xea7,0xeb0, 0xeb2,0xeb2, 0xebd,0xebd, 0xec0,0xec4,
+	0xec6,0xec6, 0xedc,0xedf, 0xf00,0xf00, 0xf40,0xf47, 0xf49,0xf6c, 0xf88,0xf8c,
+	0x1000,0x102a, 0x103f,0x103f, 0x1050,0x1055, 0x105a,0x105d, 0x1061,0x1061,
+	0x1065,0x1066, 0x106e,0x1070, 0x1075,0x1081, 0x108e,0x108e, 0x10a0,0x10c5,
+	0x10c7,0x10c7, 0x10cd,0x10cd, 0x10d0,0x10fa, 0x10fc,0x1248, 0x124a,0x124d,
+	0x1250,0x1256, 0x1258,0x1258, 0x125a,0x125d, 0x1260,0x1288, 0x128a,0x128d,
+	0x1290,0x12b0, 0x12b2,0x12b5, 0x12b8,0x12be, 0x12c0,0x12c0, 0x12c2,0x12c5,
+	0x12c8,0x12d6, 0x12d8,0x1310, 0x1312,0x1315, 0x1318,0x135a, 0x1380,0x138f,
+	0x13a0,0x13f5, 0x13f8,0x13fd, 0x1401,0x166c, 0x166f,0x167f, 0x1681,0x169a,
+	0x16a0,0x16ea, 0x16ee,0x16f8, 0x1700,0x1711, 0x171f,0x1731, 0x1740,0x1751,
+	0x1760,0x176c, 0x176e,0x1770, 0x1780,0x17b3, 0x17d7,0x17d7, 0x17dc,0x17dc,
+	0x1820,0x1878, 0x1880,0x18a8, 0x18aa,0x18aa, 0x18b0,0x18f5, 0x1900,0x191e,
+	0x1950,0x196d, 0x1970,0x1974, 0x1980,0x19ab, 0x19b0,0x19c9, 0x1a00,0x1a16,
+	0x1a20,0x1a54, 0x1aa7,0x1aa7, 0x1b05,0x1b33, 0x1b45,0x1b4c, 0x1b83,0x1ba0,
+	0x1bae,0x1baf, 0x1bba,0x1be5, 0x1c00,0x1c23, 0x1c4d,0x1c4f, 0x1c5a,0x1c7d,
+	0x1c80,0x1c88, 0x1c90,0x1cba, 0x1cbd,0x1cbf, 0x1ce9,0x1cec, 0x1cee,0x1cf3,
+	0x1cf5,0x1cf6, 0x1cfa,0x1cfa, 0x1d00,0x1dbf, 0x1e00,0x1f15, 0x1f18,0x1f1d,
+	0x1f20,0x1f45, 0x1f48,0x1f4d, 0x1f50,0x1f57, 0x1f59,0x1f59, 0x1f5b,0x1f5b,
+	0x1f5d,0x1f5d, 0x1f5f,0x1f7d, 0x1f80,0x1fb4, 0x1fb6,0x1fbc, 0x1fbe,0x1fbe,
+	0x1fc2,0x1fc4, 0x1fc6,0x1fcc, 0x1fd0,0x1fd3, 0x1fd6,0x1fdb, 0x1fe0,0x1fec,
+	0x1ff2,0x1ff4, 0x1ff6,0x1ffc, 0x2071,0x2071, 0x207f,0x207f, 0x2090,0x209c,
+	0x2102,0x2102, 0x2107,0x2107, 0x210a,0x2113, 0x2115,0x2115, 0x2118,0x211d,
+	0x2124,0x2124, 0x2126,0x2126, 0x2128,0x2128, 0x212a,0x2139, 0x213c,0x213f,
+	0x2145,0x2149, 0x214e,0x214e, 0x2160,0x2188, 0x2c00,0x2ce4, 0x2ceb,0x2cee,
+	0x2cf2,0x2cf3, 0x2d00,0x2d25, 0x2d27,0x2d27, 0x2d2d,0x2d2d, 0x2d30,0x2d67,
+	0x2d6f,0x2d6f, 0x2d80,0x2d96, 0x2da0,0x2da6, 0x2da8,0x2dae, 0x2db0,0x2db6,
+	0x2db8,0x2dbe, 0x2dc0,0x2dc6, 0x2dc8,0x2dce, 0x2dd0,0x2dd6, 0x2dd8,0x2dde,
+	0x3005,0x3007, 0x3021,0x3029, 0x3031,0x3035, 0x3038,0x303c, 0x3041,0x3096,
+	0x309d,0x309f, 0x30a1,0x30fa, 0x30fc,0x30ff, 0x3105,0x312f, 0x3131,0x318e,
+	0x31a0,0x31bf, 0x31f0,0x31ff, 0x3400,0x4dbf, 0x4e00,0xa48c, 0xa4d0,0xa4fd,
+	0xa500,0xa60c, 0xa610,0xa61f, 0xa62a,0xa62b, 0xa640,0xa66e, 0xa67f,0xa69d,
+	0xa6a0,0xa6ef, 0xa717,0xa71f, 0xa722,0xa788, 0xa78b,0xa7ca, 0xa7d0,0xa7d1,
+	0xa7d3,0xa7d3, 0xa7d5,0xa7d9, 0xa7f2,0xa801, 0xa803,0xa805, 0xa807,0xa80a,
+	0xa80c,0xa822, 0xa840,0xa873, 0xa882,0xa8b3, 0xa8f2,0xa8f7, 0xa8fb,0xa8fb,
+	0xa8fd,0xa8fe, 0xa90a,0xa925, 0xa930,0xa946, 0xa960,0xa97c, 0xa984,0xa9b2,
+	0xa9cf,0xa9cf, 0xa9e0,0xa9e4, 0xa9e6,0xa9ef, 0xa9fa,0xa9fe, 0xaa00,0xaa28,
+	0xaa40,0xaa42, 0xaa44,0xaa4b, 0xaa60,0xaa76, 0xaa7a,0xaa7a, 0xaa7e,0xaaaf,
+	0xaab1,0xaab1, 0xaab5,0xaab6, 0xaab9,0xaabd, 0xaac0,0xaac0, 0xaac2,0xaac2,
+	0xaadb,0xaadd, 0xaae0,0xaaea, 0xaaf2,0xaaf4, 0xab01,0xab06, 0xab09,0xab0e,
+	0xab11,0xab16, 0xab20,0xab26, 0xab28,0xab2e, 0xab30,0xab5a, 0xab5c,0xab69,
+	0xab70,0xabe2, 0xac00,0xd7a3, 0xd7b0,0xd7c6, 0xd7cb,0xd7fb, 0xf900,0xfa6d,
+	0xfa70,0xfad9, 0xfb00,0xfb06, 0xfb13,0xfb17, 0xfb1d,0xfb1d, 0xfb1f,0xfb28,
+	0xfb2a,0xfb36, 0xfb38,0xfb3c, 0xfb3e,0xfb3e, 0xfb40,0xfb41, 0xfb43,0xfb44,
+	0xfb46,0xfbb1, 0xfbd3,0xfc5d, 0xfc64,0xfd3d, 0xfd50,0xfd8f, 0xfd92,0xfdc7,
+	0xfdf0,0xfdf9, 0xfe71,0xfe71, 0xfe73,0xfe73, 0xfe77,0xfe77, 0xfe79,0xfe79,
+	0xfe7b,0xfe7b, 0xfe7d,0xfe7d, 0xfe7f,0xfefc, 0xff21,0xff3a, 0xff41,0xff5a,
+	0xff66,0xff9d, 0xffa0,0xffbe, 0xffc2,0xffc7, 0xffca,0xffcf, 0xffd2,0xffd7,
+	0xffda,0xffdc, 0x10000,0x1000b, 0x1000d,0x10026, 0x10028,0x1003a,
+	0x1003c,0x1003d, 0x1003f,0x1004d, 0x10050,0x1005d, 0x10080,0x100fa,
+	0x10140,0x10174, 0x10280,0x1029c, 0x102a0,0x102d0, 0x10300,0x1031f,
+	0x1032d,0x1034a, 0x10350,0x10375, 0x10380,0x1039d, 0x103a0,0x103c3,
+	0x103c8,0x103cf, 0x103d1,0x103d5, 0x10400,0x1049d, 0x104b0,0x104d3,
+	0x104d8,0x104fb, 0x10500,0x10527, 0x10530,0x10563, 0x10570,0x1057a,
+	0x1057c,0x1058a, 0x1058c,0x10592, 0x10594,0x10595, 0x10597,0x105a1,
+	0x105a3,0x105b1, 0x105b3,0x105b9, 0x105bb,0x105bc, 0x10600,0x10736,
+	0x10740,0x10755, 0x10760,0x10767, 0x10780,0x10785, 0x10787,0x107b0,
+	0x107b2,0x107ba, 0x10800,0x10805, 0x10808,0x10808, 0x1080a,0x10835,
+	0x10837,0x10838, 0x1083c,0x1083c, 0x1083f,0x10855, 0x10860,0x10876,
+	0x10880,0x1089e, 0x108e0,0x108f2, 0x108f4,0x108f5, 0x10900,0x10915,
+	0x10920,0x10939, 0x10980,0x109b7, 0x109be,0x109bf, 0x10a00,0x10a00,
+	0x10a10,0x10a13, 0x10a15,0x10a17, 0x10a19,0x10a35, 0x10a60,0x10a7c,
+	0x10a80,0x10a9c, 0x10ac0,0x10ac7, 0x10ac9,0x10ae4, 0x10b00,0x10b35,
+	0x10b40,0x10b55, 0x10b60,0x10b72, 0x10b80,0x10b91, 0x10c00,0x10c48,
+	0x10c80,0x10cb2, 0x10cc0,0x10cf2, 0x10d00,0x10d23, 0x10e80,0x10ea9,
+	0x10eb0,0x10eb1, 0x10f00,0x10f1c, 0x10f27,0x10f27, 0x10f30,0x10f45,
+	0x10f70,0x10f81, 0x10fb0,0x10fc4, 0x10fe0,0x10ff6, 0x11003,0x11037,
+	0x11071,0x11072, 0x11075,0x11075, 0x11083,0x110af, 0x110d0,0x110e8,
+	0x11103,0x11126, 0x11144,0x11144, 0x11147,0x11147, 0x11150,0x11172,
+	0x11176,0x11176, 0x11183,0x111b2, 0x111c1,0x111c4, 0x111da,0x111da,
+	0x111dc,0x111dc, 0x11200,0x11211, 0x11213,0x1122b, 0x11280,0x11286,
+	0x11288,0x11288, 0x1128a,0x1128d, 0x1128f,0x1129d, 0x1129f,0x112a8,
+	0x112b0,0x112de, 0x11305,0x1130c, 0x1130f,0x11310, 0x11313,0x11328,
+	0x1132a,0x11330, 0x11332,0x11333, 0x11335,0x11339, 0x1133d,0x1133d,
+	0x11350,0x11350, 0x1135d,0x11361, 0x11400,0x11434, 0x11447,0x1144a,
+	0x1145f,0x11461, 0x11480,0x114af, 0x114c4,0x114c5, 0x114c7,0x114c7,
+	0x11580,0x115ae, 0x115d8,0x115db, 0x11600,0x1162f, 0x11644,0x11644,
+	0x11680,0x116aa, 0x116b8,0x116b8, 0x11700,0x1171a, 0x11740,0x11746,
+	0x11800,0x1182b, 0x118a0,0x118df, 0x118ff,0x11906, 0x11909,0x11909,
+	0x1190c,0x11913, 0x11915,0x11916, 0x11918,0x1192f, 0x1193f,0x1193f,
+	0x11941,0x11941, 0x119a0,0x119a7, 0x119aa,0x119d0, 0x119e1,0x119e1,
+	0x119e3,0x119e3, 0x11a00,0x11a00, 0x11a0b,0x11a32, 0x11a3a,0x11a3a,
+	0x11a50,0x11a50, 0x11a5c,0x11a89, 0x11a9d,0x11a9d, 0x11ab0,0x11af8,
+	0x11c00,0x11c08, 0x11c0a,0x11c2e, 0x11c40,0x11c40, 0x11c72,0x11c8f,
+	0x11d00,0x11d06, 0x11d08,0x11d09, 0x11d0b,0x11d30, 0x11d46,0x11d46,
+	0x11d60,0x11d65, 0x11d67,0x11d68, 0x11d6a,0x11d89, 0x11d98,0x11d98,
+	0x11ee0,0x11ef2, 0x11fb0,0x11fb0, 0x12000,0x12399, 0x12400,0x1246e,
+	0x12480,0x12543, 0x12f90,0x12ff0, 0x13000,0x1342e, 0x14400,0x14646,
+	0x16800,0x16a38, 0x16a40,0x16a5e, 0x16a70,0x16abe, 0x16ad0,0x16aed,
+	0x16b00,0x16b2f, 0x16b40,0x16b43, 0x16b63,0x16b77, 0x16b7d,0x16b8f,
+	0x16e40,0x16e7f, 0x16f00,0x16f4a, 0x16f50,0x16f50, 0x16f93,0x16f9f,
+	0x16fe0,0x16fe1, 0x16fe3,0x16fe3, 0x17000,0x187f7, 0x18800,0x18cd5,
+	0x18d00,0x18d08, 0x1aff0,0x1aff3, 0x1aff5,0x1affb, 0x1affd,0x1affe,
+	0x1b000,0x1b122, 0x1b150,0x1b152, 0x1b164,0x1b167, 0x1b170,0x1b2fb,
+	0x1bc00,0x1bc6a, 0x1bc70,0x1bc7c, 0x1bc80,0x1bc88, 0x1bc90,0x1bc99,
+	0x1d400,0x1d454, 0x1d456,0x1d49c, 0x1d49e,0x1d49f, 0x1d4a2,0x1d4a2,
+	0x1d4a5,0x1d4a6, 0x1d4a9,0x1d4ac, 0x1d4ae,0x1d4b9, 0x1d4bb,0x1d4bb,
+	0x1d4bd,0x1d4c3, 0x1d4c5,0x1d505, 0x1d507,0x1d50a, 0x1d50d,0x1d514,
+	0x1d516,0x1d51c, 0x1d51e,0x1d539, 0x1d53b,0x1d53e, 0x1d540,0x1d544,
+	0x1d546,0x1d546, 0x1d54a,0x1d550, 0x1d552,0x1d6a5, 0x1d6a8,0x1d6c0,
+	0x1d6c2,0x1d6da, 0x1d6dc,0x1d6fa, 0x1d6fc,0x1d714, 0x1d716,0x1d734,
+	0x1d736,0x1d74e, 0x1d750,0x1d76e, 0x1d770,0x1d788, 0x1d78a,0x1d7a8,
+	0x1d7aa,0x1d7c2, 0x1d7c4,0x1d7cb, 0x1df00,0x1df1e, 0x1e100,0x1e12c,
+	0x1e137,0x1e13d, 0x1e14e,0x1e14e, 0x1e290,0x1e2ad, 0x1e2c0,0x1e2eb,
+	0x1e7e0,0x1e7e6, 0x1e7e8,0x1e7eb, 0x1e7ed,0x1e7ee, 0x1e7f0,0x1e7fe,
+	0x1e800,0x1e8c4, 0x1e900,0x1e943, 0x1e94b,0x1e94b, 0x1ee00,0x1ee03,
+	0x1ee05,0x1ee1f, 0x1ee21,0x1ee22, 0x1ee24,0x1ee24, 0x1ee27,0x1ee27,
+	0x1ee29,0x1ee32, 0x1ee34,0x1ee37, 0x1ee39,0x1ee39, 0x1ee3b,0x1ee3b,
+	0x1ee42,0x1ee42, 0x1ee47,0x1ee47, 0x1ee49,0x1ee49, 0x1ee4b,0x1ee4b,
+	0x1ee4d,0x1ee4f, 0x1ee51,0x1ee52, 0x1ee54,0x1ee54, 0x1ee57,0x1ee57,
+	0x1ee59,0x1ee59, 0x1ee5b,0x1ee5b, 0x1ee5d,0x1ee5d, 0x1ee5f,0x1ee5f,
+	0x1ee61,0x1ee62, 0x1ee64,0x1ee64, 0x1ee67,0x1ee6a, 0x1ee6c,0x1ee72,
+	0x1ee74,0x1ee77, 0x1ee79,0x1ee7c, 0x1ee7e,0x1ee7e, 0x1ee80,0x1ee89,
+	0x1ee8b,0x1ee9b, 0x1eea1,0x1eea3, 0x1eea5,0x1eea9, 0x1eeab,0x1eebb,
+	0x20000,0x2a6df, 0x2a700,0x2b738, 0x2b740,0x2b81d, 0x2b820,0x2cea1,
+	0x2ceb0,0x2ebe0, 0x2f800,0x2fa1d, 0x30000,0x3134a
+    };
+    static const utf8_class cc(
+	char_class(isalpha), ranges, sizeof(ranges) / sizeof(*ranges) / 2);
+    return cc;
+}
+
+// xid_continue(): code points that can continue an identifier, or XID_Continue (14.0)
+inline const utf8_class &xid_continue()
+{
+    // in addition to xid_start()
+    static const char32_t ranges[] = {
+	0xb7,0xb7, 0x300,0x36f, 0x387,0x387, 0x483,0x487, 0x591,0x5bd, 0x5bf,0x5bf,
+	0x5c1,0x5c2, 0x5c4,0x5c5, 0x5c7,0x5c7, 0x610,0x61a, 0x64b,0x669, 0x670,0x670,
+	0x6d6,0x6dc, 0x6df,0x6e4, 0x6e7,0x6e8, 0x6ea,0x6ed, 0x6f0,0x6f9, 0x711,0x711,
+	0x730,0x74a, 0x7a6,0x7b0, 0x7c0,0x7c9, 0x7eb,0x7f3, 0x7fd,0x7fd, 0x816,0x819,
+	0x81b,0x823, 0x825,0x827, 0x829,0x82d, 0x859,0x85b, 0x898,0x89f, 0x8ca,0x8e1,
+	0x8e3,0x903, 0x93a,0x93c, 0x93e,0x94f, 0x951,0x957, 0x962,0x963, 0x966,0x96f,
+	0x981,0x983, 0x9bc,0x9bc, 0x9be,0x9c4, 0x9c7,0x9c8, 0x9cb,0x9cd, 0x9d7,0x9d7,
+	0x9e2,0x9e3, 0x9e6,0x9ef, 0x9fe,0x9fe, 0xa01,0xa03, 0xa3c,0xa3c, 0xa3e,0xa42,
+	0xa47,0xa48, 0xa4b,0xa4d, 0xa51,0xa51, 0xa66,0xa71, 0xa75,0xa75, 0xa81,0xa83,
+	0xabc,0xabc, 0xabe,0xac5, 0xac7,0xac9, 0xacb,0xacd, 0xae2,0xae3, 0xae6,0xaef,
+	0xafa,0xaff, 0xb01,0xb03, 0xb3c,0xb3c, 0xb3e,0xb44, 0xb47,0xb48, 0xb4b,0xb4d,
+	0xb55,0xb57, 0xb62,0xb63, 0xb66,0xb6f, 0xb82,0xb82, 0xbbe,0xbc2, 0xbc6,0xbc8,
+	0xbca,0xbcd, 0xbd7,0xbd7, 0xbe6,0xbef, 0xc00,0xc04, 0xc3c,0xc3c, 0xc3e,0xc44,
+	0xc46,0xc48, 0xc4a,0xc4d, 0xc55,0xc56, 0xc62,0xc63, 0xc66,0xc6f, 0xc81,0xc83,
+	0xcbc,0xcbc, 0xcbe,0xcc4, 0xcc6,0xcc8, 0xcca,0xccd, 0xcd5,0xcd6, 0xce2,0xce3,
+	0xce6,0xcef, 0xd00,0xd03, 0xd3b,0xd3c, 0xd3e,0xd44, 0xd46,0xd48, 0xd4a,0xd4d,
+	0xd57,0xd57, 0xd62,0xd63, 0xd66,0xd6f, 0xd81,0xd83, 0xdca,0xdca, 0xdcf,0xdd4,
+	0xdd6,0xdd6, 0xdd8,0xddf, 0xde6,0xdef, 0xdf2,0xdf3, 0xe31,0xe31, 0xe33,0xe3a,
+	0xe47,0xe4e, 0xe50,0xe59, 0xeb1,0xeb1, 0xeb3,0xebc, 0xec8,0xecd, 0xed0,0xed9,
+	0xf18,0xf19, 0xf20,0xf29, 0xf35,0xf35, 0xf37,0xf37, 0xf39,0xf39, 0xf3e,0xf3f,
+	0xf71,0xf84, 0xf86,0xf87, 0xf8d,0xf97, 0xf99,0xfbc, 0xfc6,0xfc6, 0x102b,0x103e,
+	0x1040,0x1049, 0x1056,0x1059, 0x105e,0x1060, 0x1062,0x1064, 0x1067,0x106d,
+	0x1071,0x1074, 0x1082,0x108d, 0x108f,0x109d, 0x135d,0x135f, 0x1369,0x1371,
+	0x1712,0x1715, 0x1732,0x1734, 0x1752,0x1753, 0x1772,0x1773, 0x17b4,0x17d3,
+	0x17dd,0x17dd, 0x17e0,0x17e9, 0x180b,0x180d, 0x180f,0x1819, 0x18a9,0x18a9,
+	0x1920,0x192b, 0x1930,0x193b, 0x1946,0x194f, 0x19d0,0x19da, 0x1a17,0x1a1b,
+	0x1a55,0x1a5e, 0x1a60,0x1a7c, 0x1a7f,0x1a89, 0x1a90,0x1a99, 0x1ab0,0x1abd,
+	0x1abf,0x1ace, 0x1b00,0x1b04, 0x1b34,0x1b44, 0x1b50,0x1b59, 0x1b6b,0x1b73,
+	0x1b80,0x1b82, 0x1ba1,0x1bad, 0x1bb0,0x1bb9, 0x1be6,0x1bf3, 0x1c24,0x1c37,
+	0x1c40,0x1c49, 0x1c50,0x1c59, 0x1cd0,0x1cd2, 0x1cd4,0x1ce8, 0x1ced,0x1ced,
+	0x1cf4,0x1cf4, 0x1cf7,0x1cf9, 0x1dc0,0x1dff, 0x203f,0x2040, 0x2054,0x2054,
+	0x20d0,0x20dc, 0x20e1,0x20e1, 0x20e5,0x20f0, 0x2cef,0x2cf1, 0x2d7f,0x2d7f,
+	0x2de0,0x2dff, 0x302a,0x302f, 0x3099,0x309a, 0xa620,0xa629, 0xa66f,0xa66f,
+	0xa674,0xa67d, 0xa69e,0xa69f, 0xa6f0,0xa6f1, 0xa802,0xa802, 0xa806,0xa806,
+	0xa80b,0xa80b, 0xa823,0xa827, 0xa82c,0xa82c, 0xa880,0xa881, 0xa8b4,0xa8c5,
+	0xa8d0,0xa8d9, 0xa8e0,0xa8f1, 0xa8ff,0xa909, 0xa926,0xa92d, 0xa947,0xa953,
+	0xa980,0xa983, 0xa9b3,0xa9c0, 0xa9d0,0xa9d9, 0xa9e5,0xa9e5, 0xa9f0,0xa9f9,
+	0xaa29,0xaa36, 0xaa43,0xaa43, 0xaa4c,0xaa4d, 0xaa50,0xaa59, 0xaa7b,0xaa7d,
+	0xaab0,0xaab0, 0xaab2,0xaab4, 0xaab7,0xaab8, 0xaabe,0xaabf, 0xaac1,0xaac1,
+	0xaaeb,0xaaef, 0xaaf5,0xaaf6, 0xabe3,0xabea, 0xabec,0xabed, 0xabf0,0xabf9,
+	0xfb1e,0xfb1e, 0xfe00,0xfe0f, 0xfe20,0xfe2f, 0xfe33,0xfe34, 0xfe4d,0xfe4f,
+	0xff10,0xff19, 0xff3f,0xff3f, 0xff9e,0xff9f, 0x101fd,0x101fd, 0x102e0,0x102e0,
+	0x10376,0x1037a, 0x104a0,0x104a9, 0x10a01,0x10a03, 0x10a05,0x10a06,
+	0x10a0c,0x10a0f, 0x10a38,0x10a3a, 0x10a3f,0x10a3f, 0x10ae5,0x10ae6,
+	0x10d24,0x10d27, 0x10d30,0x10d39, 0x10eab,0x10eac, 0x10f46,0x10f50,
+	0x10f82,0x10f85, 0x11000,0x11002, 0x11038,0x11046, 0x11066,0x11070,
+	0x11073,0x11074, 0x1107f,0x11082, 0x110b0,0x110ba, 0x110c2,0x110c2,
+	0x110f0,0x110f9, 0x11100,0x11102, 0x11127,0x11134, 0x11136,0x1113f,
+	0x11145,0x11146, 0x11173,0x11173, 0x11180,0x11182, 0x111b3,0x111c0,
+	0x111c9,0x111cc, 0x111ce,0x111d9, 0x1122c,0x11237, 0x1123e,0x1123e,
+	0x112df,0x112ea, 0x112f0,0x112f9, 0x11300,0x11303, 0x1133b,0x1133c,
+	0x1133e,0x11344, 0x11347,0x11348, 0x1134b,0x1134d, 0x11357,0x11357,
+	0x11362,0x11363, 0x11366,0x1136c, 0x11370,0x11374, 0x11435,0x11446,
+	0x11450,0x11459, 0x1145e,0x1145e, 0x114b0,0x114c3, 0x114d0,0x114d9,
+	0x115af,0x115b5, 0x115b8,0x115c0, 0x115dc,0x115dd, 0x11630,0x11640,
+	0x11650,0x11659, 0x116ab,0x116b7, 0x116c0,0x116c9, 0x1171d,0x1172b,
+	0x11730,0x11739, 0x1182c,0x1183a, 0x118e0,0x118e9, 0x11930,0x11935,
+	0x11937,0x11938, 0x1193b,0x1193e, 0x11940,0x11940, 0x11942,0x11943,
+	0x11950,0x11959, 0x119d1,0x119d7, 0x119da,0x119e0, 0x119e4,0x119e4,
+	0x11a01,0x11a0a, 0x11a33,0x11a39, 0x11a3b,0x11a3e, 0x11a47,0x11a47,
+	0x11a51,0x11a5b, 0x11a8a,0x11a99, 0x11c2f,0x11c36, 0x11c38,0x11c3f,
+	0x11c50,0x11c59, 0x11c92,0x11ca7, 0x11ca9,0x11cb6, 0x11d31,0x11d36,
+	0x11d3a,0x11d3a, 0x11d3c,0x11d3d, 0x11d3f,0x11d45, 0x11d47,0x11d47,
+	0x11d50,0x11d59, 0x11d8a,0x11d8e, 0x11d90,0x11d91, 0x11d93,0x11d97,
+	0x11da0,0x11da9, 0x11ef3,0x11ef6, 0x16a60,0x16a69, 0x16ac0,0x16ac9,
+	0x16af0,0x16af4, 0x16b30,0x16b36, 0x16b50,0x16b59, 0x16f4f,0x16f4f,
+	0x16f51,0x16f87, 0x16f8f,0x16f92, 0x16fe4,0x16fe4, 0x16ff0,0x16ff1,
+	0x1bc9d,0x1bc9e, 0x1cf00,0x1cf2d, 0x1cf30,0x1cf46, 0x1d165,0x1d169,
+	0x1d16d,0x1d172, 0x1d17b,0x1d182, 0x1d185,0x1d18b, 0x1d1aa,0x1d1ad,
+	0x1d242,0x1d244, 0x1d7ce,0x1d7ff, 0x1da00,0x1da36, 0x1da3b,0x1da6c,
+	0x1da75,0x1da75, 0x1da84,0x1da84, 0x1da9b,0x1da9f, 0x1daa1,0x1daaf,
+	0x1e000,0x1e006, 0x1e008,0x1e018, 0x1e01b,0x1e021, 0x1e023,0x1e024,
+	0x1e026,0x1e02a, 0x1e130,0x1e136, 0x1e140,0x1e149, 0x1e2ae,0x1e2ae,
+	0x1e2ec,0x1e2f9, 0x1e8d0,0x1e8d6, 0x1e944,0x1e94a, 0x1e950,0x1e959,
+	0x1fbf0,0x1fbf9, 0xe0100,0xe01ef
+    };
+    static const utf8_class cc = xid_start()
+	| utf8_class(char_class(isalnum) | char_class("_"),
+	    ranges, sizeof(ranges) / sizeof(*ranges) / 2);
+    return cc;
+}
+
+// get_utf8(s, cc, c): consume a code point of cc into c. "weak failure" if cc has no
+// member starting with the next byte, and "error failure" if the sequence turns out to
+// be malformed or not in cc after its first byte, as parsers are LL(1) over bytes.
+inline void get_utf8(std::istream &s, const utf8_class &cc, char32_t &c)
+{
+    MARK;
+    char u[4];
+    int x = s.peek();
+    if ( x == EOF || !cc.starts(char(x)) ) {
+	s.setstate(std::ios::failbit);
+	return; // "weak failure"
+    }
+    for ( int n = 0 ; ; ) {
+	s.ignore(); // consume the byte
+	update_pos(s);
+	u[n++] = char(x);
+	const char *const m = utf8_decode(u, u + n, c);
+	if ( m == u + n && cc.contains(c) )
+	    return;
+	if ( m || (x = s.peek()) == EOF || (x & 0xc0) != 0x80 ) {
+	    s.setstate(std::ios::failbit);
+	    RETURN(); // "error failure" since the first byte is consumed
+	}
+    }
+}
+
+class parser_utf8_char : public parser<char32_t> {
+protected:
+    const utf8_class cc;
+
+public:
+    char32_t operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting cc
+
+	char32_t c = 0;
+	get_utf8(s, cc, c);
+	return s.fail() ? char32_t() : c;
+    }
+
+    parser_utf8_char(const utf8_class &cc) : cc(cc) {}
+};
+
+// utf8_char(cc): code point of cc
+inline std::shared_ptr<parser<char32_t>> utf8_char(const utf8_class &cc)
+{
+    return std::shared_ptr<parser<char32_t>>(new parser_utf8_char(cc));
+}
+
+// utf8_char(): any valid code point
+inline std::shared_ptr<parser<char32_t>> utf8_char()
+{
+    return utf8_char(utf8_class(0, 0x10ffff));
+}
+
+class parser_utf8_take_while : public parser<std::string> {
+protected:
+    const utf8_class cc;
+    const bool one; // at least one code point required
+    const utf8_class head; // code points allowed first if one
+
+    // next(s, cc, t): consume the code point at s into t if it is in cc and return true,
+    // or leave it unconsumed and return false. It is decoded in the get area of the
+    // nested streambuf before consuming anything, or else, for a sequence across the
+    // get area, read byte by byte and put back (or sought back) if not in cc (or
+    // malformed); a streambuf able to do neither throws InputError.
+    static bool next(std::istream &s, const utf8_class &cc, std::string &t) {
+	pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+	std::streambuf *const b = ps->nested();
+	const int x = b->sgetc(); // unlike s.peek(), never setting eofbit
+	if ( x == EOF || !cc.starts(char(x)) )
+	    return false;
+	const char *a = nullptr, *m = nullptr;
+	char32_t c;
+	for ( std::size_t k = 1 ; !m && k <= 4 && (a = ps->ahead(k)) ; k++ )
+	    m = utf8_decode(a, a + k, c);
+	if ( m ) { // in the get area
+	    if ( m == a || !cc.contains(c) )
+		return false;
+	    t.append(a, m);
+	    ps->pos.update(a, m);
+	    ps->c = m[-1];
+	    for ( ; a != m ; a++ )
+		b->sbumpc();
+	    return true;
+	}
+
+	char u[4];
+	int n = 0;
+	do
+	    u[n++] = char(b->sbumpc());
+	while ( !(m = utf8_decode(u, u + n, c)) && n < 4 && b->sgetc() != EOF );
+	if ( m == u + n && cc.contains(c) ) {
+	    t.append(u, n);
+	    ps->pos.update(u, u + n);
+	    ps->c = u[n-1];
+	    return true;
+	}
+	int k = n;
+	while ( k && b->sputbackc(u[k-1]) != EOF )
+	    k--;
+	if ( k && b->pubseekoff(-k, std::ios_base::cur, std::ios_base::in)
+	    == std::streampos(std::streamoff(-1)) ) {
+	    const InputError e = { "unable to put back a UTF-8 sequence" };
+	    throw e;
+	}
+	return false;
+    }
+
+public:
+    std::string operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting cc
+
+	pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+	std::string t(pooled<std::string>(s));
+	if ( one && !next(s, head, t) ) {
+	    s.setstate(std::ios::failbit); // "weak failure"
+	    return t;
+	}
+	do
+	    ps->scan(cc, &t); // stopping at a sequence across the get area, if not in cc
+	while ( next(s, cc, t) );
+	return t;
+    }
+
+    parser_utf8_take_while(const utf8_class &cc, bool one, const utf8_class &head)
+    : cc(cc), one(one), head(head) {}
+};
+
+// take_while(cc) for a utf8_class cc: code points of cc as a UTF-8 string
+inline std::shared_ptr<parser<std::string>> take_while(const utf8_class &cc)
+{
+    return std::shared_ptr<parser<std::string>>(new parser_utf8_take_while(
+	cc, false, utf8_class() ));
+}
+
+// take_while1(cc) for a utf8_class cc: one or more code points of cc
+inline std::shared_ptr<parser<std::string>> take_while1(const utf8_class &cc)
+{
+    return std::shared_ptr<parser<std::string>>(new parser_utf8_take_while(
+	cc, true, cc ));
+}
+
+// utf8_ident(): identifier of a code point of XID_Start (or '_') and XID_Continue's
+inline std::shared_ptr<parser<std::string>> utf8_ident()
+{
+    return std::shared_ptr<parser<std::string>>(new parser_utf8_take_while(
+	xid_continue(), true, xid_start() | utf8_class(char_class("_")) ));
+}
+
+
+
+class parser_eof : public parser<void> {
+public:
+    void operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting eof
+
+	if ( !(s.eof() || s.peek() == EOF) ) { // may possibly set eofbit
+	    s.setstate(std::ios::failbit); // mark failure if not eof
+	    expect(s, this);
+	}
+	// no need for s.ignore() and s.rdbuf()->update() on eof
+    }
+
+    parser_node describe() const override { return parser_node(parser_node::END); }
+
+    parser_eof() {}
+};
+
+// eof()
+inline std::shared_ptr<parser<void>> eof()
+{
+    return share(std::shared_ptr<parser<void>>(new parser_eof()));
+}
+//inline std::shared_ptr<parser<void>> eof() { return skip(EOF); }
+    // This is not working because after peeking eof s.ignore() will mark the failbit.
+
+
+
+template <typename T>
+class parser_skip : public parser<void> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+
+public:
+    // the result dropped is given back to the pool of s, if any
+    void operator()(std::istream &s) const override { recycle(s, p->operator()(s)); }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SKIP, p.get());
+    }
+
+    parser_skip(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
+};
+
+template <>
+inline void parser_skip<void>::operator()(std::istream &s) const { p->operator()(s); }
+
+// skip(p): parse p and return nothing
+template <typename T>
+inline std::shared_ptr<parser<void>> skip(std::shared_ptr<parser<T>> p)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_skip<T>(std::move(p))));
+}
+
+// skip('c'): character-matching void parser
+inline std::shared_ptr<parser<void>> skip(char c) { return skip(chr(c)); }
+
+
+
+#include <utility> // for std::declval()
+#include <type_traits> // for std::decay
+
+// call_result<F, A...>::type is the (decayed) result type of calling an F object with
+// arguments of types A..., and is not defined if F is not callable so.
+template <class S, class F, class... A>
+struct call_result_ {};
+
+template <class F, class... A>
+struct call_result_<decltype(void(std::declval<const F &>()(std::declval<A>()...))),
+    F, A...> {
+    typedef typename std::decay<
+	decltype(std::declval<const F &>()(std::declval<A>()...))>::type type;
+};
+
+template <class F, class... A>
+struct call_result : call_result_<void, F, A...> {};
+
+// action_result<U, F>::type is the result type of f(U), or f() if U is void
+template <typename U, class F>
+struct action_result : call_result<F, U> {};
+
+template <class F>
+struct action_result<void, F> : call_result<F> {};
+
+inline std::string char_to_string(char c);
+
+// whether f is char_to_string, which converts a character parser into a string parser
+// without any semantic action
+template <class F>
+inline bool converts_char(const F &) { return false; }
+inline bool converts_char(std::string (*f)(char)) { return f == char_to_string; }
+
+template <typename U, typename T, class F>
+// F is any callable such as a function pointer, a functor or a lambda, which is stored
+// by value so that it can be inlined into the parser.
+class parser_map : public parser<T> {
+protected:
+    const std::shared_ptr<parser<U>> p;
+    const F f;
+
+public:
+    T operator()(std::istream &s) const override {
+	U u(p->operator()(s)); //or const U &u??
+	if ( s.fail() )
+	    return T(); // return the default value of T if failed
+	return f(u);
+    }
+
+    parser_node describe() const override {
+	parser_node n(parser_node::MAP, p.get());
+	n.action = !converts_char(f);
+	return n;
+    }
+
+    parser_map(std::shared_ptr<parser<U>> p, F f) : p(std::move(p)), f(std::move(f)) {}
+};
+
+template <typename T, class F>
+class parser_map<void, T, F> : public parser<T> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+    const F f;
+
+public:
+    T operator()(std::istream &s) const override {
+	p->operator()(s);
+	if ( s.fail() )
+	    return T(); // return the default value of T if failed
+	return f();
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::MAP, p.get());
+    }
+
+    parser_map(std::shared_ptr<parser<void>> p, F f) : p(std::move(p)), f(std::move(f)) {}
+};
+
+// "p >> f": parse p, and if p succeeds apply T f(U) to the result from p, or T f() if p
+// is a void parser (that is, "p >> return f()" in Haskell)
+// operator>() could be used rather than operator>>(), but for the sake of readability
+template <typename U, class F>
+inline std::shared_ptr<parser<typename action_result<U, F>::type>> operator>>(
+    std::shared_ptr<parser<U>> p, F f)
+{
+    typedef typename action_result<U, F>::type T;
+    return std::shared_ptr<parser<T>>(new parser_map<U, T, F>(
+	std::move(p), std::move(f) ));
+}
+
+
+
+class parser_cat : public parser<std::string> {
+protected:
+    const std::shared_ptr<parser<std::string>> p;
+    const std::shared_ptr<parser<std::string>> q;
+
+public:
+    std::string operator()(std::istream &s) const override {
+	MARK;
+	std::string t(p->operator()(s));
+	if ( !s.fail() ) {
+	    std::string u(q->operator()(s));
+	    t.append(u);
+	    recycle(s, std::move(u));
+	    CHECK;
+	}
+	return t;
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::CAT, p.get(), q.get());
+    }
+
+    parser_cat(
+	std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<std::string>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// "p + q": concatenation of string parsers
+inline std::shared_ptr<parser<std::string>> operator+(
+    std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<std::string>> q)
+{
+    return share(std::shared_ptr<parser<std::string>>(new parser_cat(
+	std::move(p), std::move(q) )));
+}
+
+inline std::string char_to_string(char c) { return std::string(1, c); }
+
+// "+p": unary operator for converting a character parser into a string parser
+inline std::shared_ptr<parser<std::string>> operator+(std::shared_ptr<parser<char>> p)
+{
+    return std::move(p) >> char_to_string;
+}
+
+// "p + q" when p is a character parser
+inline std::shared_ptr<parser<std::string>> operator+(
+    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<std::string>> q)
+{
+    return +std::move(p) + std::move(q);
+}
+
+// "p + q" when q is a character parser
+inline std::shared_ptr<parser<std::string>> operator+(
+    std::shared_ptr<parser<std::string>> p, std::shared_ptr<parser<char>> q)
+{
+    return std::move(p) + +std::move(q);
+}
+
+// "p + q" when both are character parsers
+inline std::shared_ptr<parser<std::string>> operator+(
+    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<char>> q)
+{
+    return +std::move(p) + +std::move(q);
+}
+
+
+
+template <class C>
+// T(== C::value_type) is type of the result from p, C is type of a (generic) container
+// for Ts.
+class parser_many : public parser<C> {
+protected:
+    const std::shared_ptr<parser<typename C::value_type>> p;
+	// parser to apply repeatedly
+
+public:
+    C operator()(std::istream &s) const override {
+	for ( C c(pooled<C>(s)) ;; ) {
+	    charge(s); // even if p consumes nothing
+	    const flat_tree::mark m = tree_mark(s);
+	    typename C::value_type t(p->operator()(s)); //or const C::value_type &t??
+	    if ( s.fail() ) {
+		// recover failure, since the failure is used to check only for the end
+		// of the combined parser and the combined parser will always result in
+		// success as an optional parser.
+		recycle(s, std::move(t));
+		tree_rollback(s, m); // drop empty nodes from p
+		clear_weak(s);
+		return c; // c is moved out
+	    }
+	    c.insert(c.end(), std::move(t)); // build up result
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::MANY, p.get());
+    }
+
+    parser_many(std::shared_ptr<parser<typename C::value_type>> p)
+    : p(std::move(p)) {}
+};
+
+// many<C>(p): parse /p*/ and return the collection of results from p's in a C container
+template <class C>
+inline std::shared_ptr<parser<C>> many(std::shared_ptr<parser<typename C::value_type>> p)
+{
+    return share(std::shared_ptr<parser<C>>(new parser_many<C>( std::move(p) )));
+}
+
+// many(p) when p is a character parser
+inline std::shared_ptr<parser<std::string>> many(std::shared_ptr<parser<char>> p)
+// no specialization "template <>", otherwise the compiler could not deduce C from the
+// element type C::value_type; e.g., std::vector<char> and std::string have the same
+// value_type.
+{
+    return many<std::string>(std::move(p));
+    // equivalently,
+    //return std::shared_ptr<parser<std::string>>(new parser_many<std::string>(
+	//std::move(p) ));
+}
+
+template <>
+class parser_many<void> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+
+public:
+    void operator()(std::istream &s) const override {
+	flat_tree::mark m;
+	do {
+	    charge(s);
+	    m = tree_mark(s);
+	    p->operator()(s);
+	} while ( !s.fail() );
+	tree_rollback(s, m); // drop empty nodes from p
+	clear_weak(s);
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::MANY, p.get());
+    }
+
+    parser_many(std::shared_ptr<parser<void>> p) : p(std::move(p)) {}
+};
+
+// many(p) when p is a void parser
+inline std::shared_ptr<parser<void>> many(std::shared_ptr<parser<void>> p)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_many<void>( std::move(p) )));
+}
+
+template <typename T, class F>
+// F is any callable of f(T), whose result is ignored
+class parser_many_each : public parser<void> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const F f; // sink
+
+public:
+    void operator()(std::istream &s) const override {
+	for ( ;; ) {
+	    charge(s);
+	    const flat_tree::mark m = tree_mark(s);
+	    T t(p->operator()(s));
+	    if ( s.fail() )
+		return tree_rollback(s, m), clear_weak(s); // always success as many(p) is
+	    f(std::move(t)); // hand over each result as soon as parsed, not keeping it
+	}
+    }
+
+    parser_many_each(std::shared_ptr<parser<T>> p, F f)
+    : p(std::move(p)), f(std::move(f)) {}
+};
+
+// many_each(p, f): parse /p*/ and pass each result from p to f as it is parsed, in
+// constant memory rather than collecting the results like many<C>(p)
+template <typename T, class F>
+inline std::shared_ptr<parser<void>> many_each(std::shared_ptr<parser<T>> p, F f)
+{
+    return std::shared_ptr<parser<void>>(new parser_many_each<T, F>(
+	std::move(p), std::move(f) ));
+}
+
+// blanks(): optional void parser consuming blanks
+inline std::shared_ptr<parser<void>> blanks()
+{
+    return skip_while(char_class(" \t"));
+    // equivalently but one by one,
+    //return many(skip(blank()));
+}
+
+
+
+template <typename T, class F =void>
+// F is any callable of T f(T, T) (but void for a void parser)
+class parser_many1 : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const F f; // combiner
+
+public:
+    T operator()(std::istream &s) const override {
+	T c(p->operator()(s));
+	if ( s.fail() )
+	    return c; // we must parse p at least once
+	for ( ;; ) {
+	    charge(s);
+	    const flat_tree::mark m = tree_mark(s);
+	    T t(p->operator()(s)); //or const T &t??
+	    if ( s.fail() )
+		// recover failure, since the failure is used to check only for the end
+		// of the combined parser and the combined parser will result in success
+		// for 2nd or later parse failure.
+		return tree_rollback(s, m), clear_weak(s), c; // c is passed by copying
+	    c = f(c, t); // build up result
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::MANY1, p.get());
+    }
+
+    parser_many1(std::shared_ptr<parser<T>> p, F f) : p(std::move(p)), f(std::move(f)) {}
+};
+
+// many1(p, f): parse /p+/ and return the collection of results from p's using T f(T, T)
+template <typename T, class F>
+inline std::shared_ptr<parser<T>> many1(std::shared_ptr<parser<T>> p, F f)
+{
+    return std::shared_ptr<parser<T>>(new parser_many1<T, F>(
+	std::move(p), std::move(f) ));
+}
+
+template <>
+class parser_many1<void> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+
+public:
+    void operator()(std::istream &s) const override {
+	p->operator()(s);
+	if ( !s.fail() ) { // we must parse p at least once
+	    flat_tree::mark m;
+	    do {
+		charge(s);
+		m = tree_mark(s);
+		p->operator()(s);
+	    } while ( !s.fail() );
+	    tree_rollback(s, m); // drop empty nodes from p
+	    clear_weak(s);
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::MANY1, p.get());
+    }
+
+    parser_many1(std::shared_ptr<parser<void>> p) : p(std::move(p)) {}
+};
+
+// many1(p) when p is a void parser
+inline std::shared_ptr<parser<void>> many1(std::shared_ptr<parser<void>> p)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_many1<void>( std::move(p) )));
+}
+
+// many1(p) for a character parser p and more general many1<C>(p) are not provided as now
+
+
+
+/* // for supporting function parsers that are not so useful as parsing functions
+template <typename U, typename T>
+class parser_chain : public parser<T> {
+protected:
+    const std::shared_ptr<parser<U>> p;
+    const std::shared_ptr<parser<T, U>> q;
+
+public:
+    T operator()(std::istream &s) const override {
+	MARK;
+	U u(p->operator()(s)); //or const U &u??
+	if ( s.fail() )
+	    return T();
+	T t(q->operator()(s, u)); //or const T &t??
+	RETURN(t);
+    }
+
+    parser_chain(std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T, U>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+template <typename U, typename T>
+inline std::shared_ptr<parser<T>> operator>>(
+    std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T, U>> q)
+{
+    return std::shared_ptr<parser<T>>(new parser_chain<U, T>(
+	std::move(p), std::move(q) ));
+}
+*/
+
+// chaining a parser and a parsing(consuming stream) function (rather than a function
+// parser) since a parsing function is easier to write in C/C++ than a function parser
+// which should be defined through a derived parser class. A parsing function is the same
+// as the normal function except it takes istream & as an additional argument.
+
+// parsing_result<U, F>::type is the result type of f(istream &, U), or f(istream &) if U
+// is void
+template <typename U, class F>
+struct parsing_result : call_result<F, std::istream &, U> {};
+
+template <class F>
+struct parsing_result<void, F> : call_result<F, std::istream &> {};
+
+template <typename U, typename T, class F>
+class parser_chain : public parser<T> {
+protected:
+    const std::shared_ptr<parser<U>> p;
+    const F f;
+
+public:
+    T operator()(std::istream &s) const override {
+	U u(p->operator()(s)); //or const U &u??
+	if ( s.fail() )
+	    return T(); // return the default value of T if failed
+	return f(s, u);
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::CHAIN, p.get());
+    }
+
+    parser_chain(std::shared_ptr<parser<U>> p, F f) : p(std::move(p)), f(std::move(f)) {}
+};
+
+template <typename T, class F>
+class parser_chain<void, T, F> : public parser<T> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+    const F f;
+
+public:
+    T operator()(std::istream &s) const override {
+	p->operator()(s);
+	if ( s.fail() )
+	    return T(); // return the default value of T if failed
+	return f(s);
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::CHAIN, p.get());
+    }
+
+    parser_chain(std::shared_ptr<parser<void>> p, F f)
+    : p(std::move(p)), f(std::move(f)) {}
+};
+
+// "p >> f": parse p, and if p succeeds apply T f(s, U) to the result U from p, or
+// T f(s) if p is a void parser
+// operator>() could be used rather than operator>>(), but for the sake of readability
+template <typename U, class F>
+inline std::shared_ptr<parser<typename parsing_result<U, F>::type>> operator>>(
+    std::shared_ptr<parser<U>> p, F f)
+{
+    typedef typename parsing_result<U, F>::type T;
+    return std::shared_ptr<parser<T>>(new parser_chain<U, T, F>(
+	std::move(p), std::move(f) ));
+}
+
+
+
+template <typename U, typename T>
+// p is a U-parser and q is a T-parser
+class parser_seq : public parser<T> {
+protected:
+    const std::shared_ptr<parser<U>> p;
+    const std::shared_ptr<parser<T>> q;
+
+public:
+    T operator()(std::istream &s) const override {
+	// p and q are parsed sequentially
+	MARK;
+	p->operator()(s);
+	if ( s.fail() )
+	    // if first parser fails we do not try second parser
+	    return T(); // whether or not U is void
+	T t(q->operator()(s)); //or const T &t??
+	RETURN(t);
+	    // throw exception if second parser fails; otherwise, a sequence of parsers
+	    // with all but the last one having succeeded would escape the outer try_().
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEQ, p.get(), q.get());
+    }
+
+    parser_seq(std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// "p > q": return result from q if p and q are parsed successfully
+template <typename U, typename T>
+inline std::shared_ptr<parser<T>> operator>(
+    std::shared_ptr<parser<U>> p, std::shared_ptr<parser<T>> q)
+{
+    return share(std::shared_ptr<parser<T>>(new parser_seq<U, T>(
+	std::move(p), std::move(q) )));
+}
+
+template <typename T>
+class parser_seq<T, void> : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const std::shared_ptr<parser<void>> q;
+
+public:
+    T operator()(std::istream &s) const override {
+	MARK;
+	T t(p->operator()(s)); //or const T &t??
+	if ( !s.fail() ) {
+	    q->operator()(s);
+	    CHECK;
+	}
+	return t;
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEQ, p.get(), q.get());
+    }
+
+    parser_seq(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<void>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+template <>
+class parser_seq<void, void> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+    const std::shared_ptr<parser<void>> q;
+
+public:
+    void operator()(std::istream &s) const override {
+	MARK;
+	p->operator()(s);
+	if ( !s.fail() ) {
+	    q->operator()(s);
+	    CHECK;
+	}
+	return;
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEQ, p.get(), q.get());
+    }
+
+    parser_seq(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// "p > q" when q is a void parser
+template <typename T>
+inline std::shared_ptr<parser<T>> operator>(
+    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<void>> q)
+{
+    return share(std::shared_ptr<parser<T>>(new parser_seq<T, void>(
+	std::move(p), std::move(q) )));
+}
+
+/* // unnecessary as a plain specialization of above operator>()
+// "p > q" when both are void parsers
+template <>
+inline std::shared_ptr<parser<void>> operator>(
+    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
+{
+    return std::shared_ptr<parser<void>>(new parser_seq<void, void>(
+	std::move(p), std::move(q) ));
+}
+*/
+
+
+
+#include <tuple> // for std::tuple
+
+// values<T...>::type is the std::tuple of the non-void types among T...
+template <class V, typename... T>
+struct values_ { typedef V type; };
+
+template <typename... V, typename... T>
+struct values_<std::tuple<V...>, void, T...> : values_<std::tuple<V...>, T...> {};
+
+template <typename... V, typename U, typename... T>
+struct values_<std::tuple<V...>, U, T...> : values_<std::tuple<V..., U>, T...> {};
+
+template <typename... T>
+struct values : values_<std::tuple<>, T...> {};
+
+template <typename... T>
+// p's are parsed sequentially into a tuple R of the results from non-void parsers
+class parser_seqn : public parser<typename values<T...>::type> {
+protected:
+    typedef typename values<T...>::type R;
+    const std::tuple<std::shared_ptr<parser<T>>...> p;
+
+    // void also past the end, since enable_if below does not short-circuit
+    template <std::size_t I>
+    struct is_void
+    : std::is_void<typename std::tuple_element<I, std::tuple<T..., void>>::type> {};
+
+    // parse the I-th parser into the J-th result of r, and the rest until a failure
+    template <std::size_t I, std::size_t J>
+    typename std::enable_if<I == sizeof...(T)>::type
+    parse(std::istream &, R &) const {}
+
+    template <std::size_t I, std::size_t J>
+    typename std::enable_if<(I < sizeof...(T)) && is_void<I>::value>::type
+    parse(std::istream &s, R &r) const {
+	std::get<I>(p)->operator()(s);
+	if ( !s.fail() )
+	    parse<I + 1, J>(s, r);
+    }
+
+    template <std::size_t I, std::size_t J>
+    typename std::enable_if<(I < sizeof...(T)) && !is_void<I>::value>::type
+    parse(std::istream &s, R &r) const {
+	std::get<J>(r) = std::get<I>(p)->operator()(s);
+	if ( !s.fail() )
+	    parse<I + 1, J + 1>(s, r);
+    }
+
+public:
+    R operator()(std::istream &s) const override {
+	MARK; // only once for the whole sequence, rather than for each of nested "p > q"
+	R r;
+	parse<0, 0>(s, r);
+	RETURN_IF_FAIL(R()); // result in "weak failure" or "error failure"
+	    // return the default value of R if failed
+	return r;
+    }
+
+    parser_seqn(std::shared_ptr<parser<T>>... p) : p(std::move(p)...) {}
+};
+
+// seq(p1, p2, ..., pn): parse p's sequentially and return the tuple of the results from
+// non-void p's; e.g., seq(key, skip('='), value) returns std::tuple<K, V>.
+template <typename... T>
+inline std::shared_ptr<parser<typename values<T...>::type>> seq(
+    std::shared_ptr<parser<T>>... p)
+{
+    return std::shared_ptr<parser<typename values<T...>::type>>(new parser_seqn<T...>(
+	std::move(p)... ));
+}
+
+// indices<0, 1, ..., N-1> as make_indices<N>::type, for unpacking a tuple
+template <std::size_t... I>
+struct indices {};
+
+template <std::size_t N, std::size_t... I>
+struct make_indices : make_indices<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct make_indices<0, I...> { typedef indices<I...> type; };
+
+// tuple_applier<F, std::tuple<V...>> applies f to the elements of a tuple as arguments
+template <class F, class R>
+struct tuple_applier;
+
+template <class F, typename... V>
+struct tuple_applier<F, std::tuple<V...>> {
+    typedef typename call_result<F, V...>::type result_type;
+    const F f;
+
+    template <std::size_t... I>
+    result_type apply(const std::tuple<V...> &r, indices<I...>) const {
+	return f(std::get<I>(r)...);
+    }
+
+    result_type operator()(const std::tuple<V...> &r) const {
+	return apply(r, typename make_indices<sizeof...(V)>::type());
+    }
+
+    tuple_applier(F f) : f(std::move(f)) {}
+};
+
+// apply(f, p1, p2, ..., pn): parse p's sequentially and apply f to the results from
+// non-void p's; that is, "seq(p1, p2, ..., pn) >> f" with the tuple unpacked.
+// for a single p, use "p >> f" instead, which also avoids std::apply found by ADL.
+template <class F, typename... T>
+inline std::shared_ptr<parser<
+    typename tuple_applier<F, typename values<T...>::type>::result_type>> apply(
+    F f, std::shared_ptr<parser<T>>... p)
+{
+    return seq(std::move(p)...)
+	>> tuple_applier<F, typename values<T...>::type>(std::move(f));
+}
+
+
+
+template <class C, typename U>
+// T(== C::value_type) is type of the result from p, C is type of a (generic) container
+// for Ts. U is type of the separator, usually void.
+class parser_sep_by : public parser<C> {
+protected:
+    const std::shared_ptr<parser<typename C::value_type>> p;
+	// parser to apply repeatedly
+    const std::shared_ptr<parser<U>> q; // separator
+
+public:
+    C operator()(std::istream &s) const override {
+	MARK;
+	C c(pooled<C>(s));
+	flat_tree::mark m = tree_mark(s);
+	typename C::value_type t(p->operator()(s)); //or const C::value_type &t??
+	if ( s.fail() ) {
+	    recycle(s, std::move(t));
+	    tree_rollback(s, m); // drop empty nodes from p
+	    clear_weak(s);
+	    return c; // return empty container
+	}
+	c.insert(c.end(), std::move(t));
+	for ( ;; ) {
+	    charge(s);
+	    m = tree_mark(s);
+	    q->operator()(s);
+	    if ( s.fail() ) {
+		// recover failure, since the failure is used to check only for the end
+		// of the combined parser and the combined parser will result in success
+		// for 2nd or later parse failure.
+		tree_rollback(s, m); // drop empty nodes from q
+		clear_weak(s);
+		return c; // c is moved out
+	    }
+	    typename C::value_type t(p->operator()(s)); //or const C::value_type &t??
+	    RETURN_IF_FAIL(C()); // must parse p after the separator
+		// return the default value of C if failed
+	    c.insert(c.end(), std::move(t)); // build up result
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEP_BY, p.get(), q.get());
+    }
+
+    parser_sep_by(
+	std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// sep_by<C>(p, q): parse /(p (q p)*)?/ and return the collection of results from p's
+// in a C container
+template <class C, typename U>
+inline std::shared_ptr<parser<C>> sep_by(
+    std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
+{
+    return share(std::shared_ptr<parser<C>>(new parser_sep_by<C, U>(
+	std::move(p), std::move(q) )));
+}
+
+// sep_by(p, q) when p is a character parser
+template <typename U>
+inline std::shared_ptr<parser<std::string>> sep_by(
+    std::shared_ptr<parser<char>> p, std::shared_ptr<parser<U>> q)
+{
+    return sep_by<std::string>(std::move(p), std::move(q));
+}
+
+template <typename U>
+class parser_sep_by<void, U> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+    const std::shared_ptr<parser<U>> q; // separator
+
+public:
+    void operator()(std::istream &s) const override {
+	MARK;
+	flat_tree::mark m = tree_mark(s);
+	p->operator()(s);
+	if ( !s.fail() )
+	    while ( m = tree_mark(s), q->operator()(s), !s.fail() ) {
+		charge(s);
+		p->operator()(s);
+		RETURN_IF_FAIL(); // must parse p after the separator
+	    }
+	tree_rollback(s, m); // drop empty nodes from p or q
+	clear_weak(s); // always success except for failure after separator
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEP_BY, p.get(), q.get());
+    }
+
+    parser_sep_by(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// sep_by(p, q) when p is a void parser
+template <typename U>
+inline std::shared_ptr<parser<void>> sep_by(
+    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_sep_by<void, U>(
+	std::move(p), std::move(q) )));
+}
+
+template <typename T, typename U, class F>
+// F is any callable of f(T), whose result is ignored
+class parser_sep_by_each : public parser<void> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const std::shared_ptr<parser<U>> q; // separator
+    const F f; // sink
+
+public:
+    void operator()(std::istream &s) const override {
+	MARK;
+	flat_tree::mark m = tree_mark(s);
+	T t(p->operator()(s));
+	if ( s.fail() )
+	    return tree_rollback(s, m), clear_weak(s); // no element
+	f(std::move(t));
+	while ( m = tree_mark(s), q->operator()(s), !s.fail() ) {
+	    charge(s);
+	    T t(p->operator()(s));
+	    RETURN_IF_FAIL(); // must parse p after the separator
+	    f(std::move(t));
+	}
+	tree_rollback(s, m); // drop empty nodes from q
+	clear_weak(s);
+    }
+
+    parser_sep_by_each(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, F f)
+    : p(std::move(p)), q(std::move(q)), f(std::move(f)) {}
+};
+
+// sep_by_each(p, q, f): parse /(p (q p)*)?/ and pass each result from p to f as it is
+// parsed, in constant memory rather than collecting the results like sep_by<C>(p, q)
+template <typename T, typename U, class F>
+inline std::shared_ptr<parser<void>> sep_by_each(
+    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, F f)
+{
+    return std::shared_ptr<parser<void>>(new parser_sep_by_each<T, U, F>(
+	std::move(p), std::move(q), std::move(f) ));
+}
+
+
+
+/* // not provided since "many1<C>(p)" is not provided either
+template <class C, typename U>
+// T(== C::value_type) is type of the result from p, C is type of a (generic) container
+// for Ts. U is type of the separator, usually void.
+class parser_sep_by1 : public parser<C> {
+protected:
+    const std::shared_ptr<parser<typename C::value_type>> p;
+	// parser to apply repeatedly
+    const std::shared_ptr<parser<U>> q; // separator
+
+public:
+    C operator()(std::istream &s) const override {
+	MARK;
+	for ( C c ;; ) {
+	    typename C::value_type t(p->operator()(s)); //or const C::value_type &t??
+	    RETURN_IF_FAIL(C()); // we must parse p at least once
+		// return the default value of C if failed
+	    c.insert(c.end(), t); // build up result
+	    q->operator()(s);
+	    if ( s.fail() )
+		// recover failure, since the failure is used to check only for the end
+		// of the combined parser and the combined parser will result in success
+		// for 2nd or later parse failure.
+		return clear_weak(s), c; // c is passed by copying
+	}
+    }
+
+    parser_sep_by1(
+	std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// sep_by1<C>(p, q): parse /(p (q p)*)?/ and return the collection of results from p's
+// in a C container
+template <class C, typename U>
+inline std::shared_ptr<parser<C>> sep_by1(
+    std::shared_ptr<parser<typename C::value_type>> p, std::shared_ptr<parser<U>> q)
+{
+    return std::shared_ptr<parser<C>>(new parser_sep_by1<C, U>(
+	std::move(p), std::move(q) ));
+}
+*/
+
+template <typename T, typename U, class F =void>
+// p is a T-parser and q is a U-parser(separator), U is usually void. F is any callable
+// of T f(T, T) (but void for a void parser).
+class parser_sep_by1 : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p; // parser to apply repeatedly
+    const std::shared_ptr<parser<U>> q; // separator
+    const F f; // combiner
+
+public:
+    T operator()(std::istream &s) const override {
+	MARK;
+	T c(p->operator()(s));
+	if ( s.fail() )
+	    return c; // we must parse p at least once
+	for ( ;; ) {
+	    charge(s);
+	    const flat_tree::mark m = tree_mark(s);
+	    q->operator()(s);
+	    if ( s.fail() )
+		// recover failure, since the failure is used to check only for the end
+		// of the combined parser and the combined parser will result in success
+		// for 2nd or later parse failure.
+		return tree_rollback(s, m), clear_weak(s), c; // c is passed by copying
+	    T t(p->operator()(s)); //or const T &t??
+	    RETURN_IF_FAIL(T()); // must parse p after the separator
+		// return the default value of T if failed
+	    c = f(c, t); // build up result
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEP_BY1, p.get(), q.get());
+    }
+
+    parser_sep_by1(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, F f)
+    : p(std::move(p)), q(std::move(q)), f(std::move(f)) {}
+};
+
+// sep_by1(p, q, f): parse /p (q p)*/ and return the collection of results from p's
+// using T f(T, T)
+template <typename T, typename U, class F>
+inline std::shared_ptr<parser<T>> sep_by1(
+    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q, F f)
+{
+    return std::shared_ptr<parser<T>>(new parser_sep_by1<T, U, F>(
+	std::move(p), std::move(q), std::move(f) ));
+}
+
+template <typename U>
+// p is a void parser and q is a U-parser(separator), U is usually void.
+class parser_sep_by1<void, U> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p; // parser to apply repeatedly
+    const std::shared_ptr<parser<U>> q; // separator
+
+public:
+    void operator()(std::istream &s) const override {
+	MARK;
+	flat_tree::mark m;
+	do {
+	    charge(s);
+	    p->operator()(s);
+	    RETURN_IF_FAIL(); // we must parse p at least once
+	    m = tree_mark(s);
+	    q->operator()(s);
+	} while ( !s.fail() );
+	tree_rollback(s, m); // drop empty nodes from q
+	clear_weak(s);
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::SEP_BY1, p.get(), q.get());
+    }
+
+    parser_sep_by1(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// sep_by1(p, q) when p is a void parser
+template <typename U>
+inline std::shared_ptr<parser<void>> sep_by1(
+    std::shared_ptr<parser<void>> p, std::shared_ptr<parser<U>> q)
+{
+    return share(std::shared_ptr<parser<void>>(new parser_sep_by1<void, U>(
+	std::move(p), std::move(q) )));
+}
+
+
+
+#include <iterator> // for std::input_iterator_tag
+
+template <typename T, typename U =void>
+// range of the results from p's (separated by q's if q is given), each parsed only when
+// the iterator advances; for ( const T &t : each(s, p) ) ... works as many_each(p, f)
+// and each(s, p, q) as sep_by_each(p, q, f), but in the caller's loop.
+class parser_each {
+protected:
+    std::istream &s;
+    const std::shared_ptr<parser<T>> p;
+    const std::shared_ptr<parser<U>> q; // separator, or nullptr if none
+    const std::streamoff _off; // to check for "error failure" as MARK does
+
+public:
+    class iterator {
+	parser_each *r; // nullptr at the end
+	T t; // the current result from p
+
+	void next(bool first) {
+	    std::istream &s = r->s;
+	    const std::streamoff _off = r->_off;
+	    charge(s);
+	    const flat_tree::mark m = tree_mark(s);
+	    if ( !first && r->q ) {
+		r->q->operator()(s);
+		if ( s.fail() ) {
+		    tree_rollback(s, m); // drop empty nodes from q
+		    clear_weak(s); // no more separator
+		    r = nullptr;
+		    return;
+		}
+	    }
+	    t = r->p->operator()(s);
+	    if ( s.fail() ) {
+		if ( first || !r->q )
+		    tree_rollback(s, m), clear_weak(s); // no more element
+		else
+		    CHECK; // must parse p after the separator
+		r = nullptr;
+	    }
+	}
+
+    public:
+	typedef std::input_iterator_tag iterator_category;
+	typedef T value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const T *pointer;
+	typedef const T &reference;
+
+	const T &operator*() const { return t; }
+	const T *operator->() const { return &t; }
+	iterator &operator++() { next(false); return *this; }
+	void operator++(int) { next(false); }
+
+	bool operator==(const iterator &i) const { return r == i.r; }
+	bool operator!=(const iterator &i) const { return r != i.r; }
+
+	iterator(parser_each *r) : r(r), t() { if ( r ) next(true); }
+    };
+
+    // begin() parses the first p, and so may be called only once
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(nullptr); }
+
+    parser_each(
+	std::istream &s, std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q)
+    : s(s), p(std::move(p)), q(std::move(q)), _off(tellg(s, 0)) {}
+};
+
+// each(s, p): range of the results from p's parsed lazily from s, as many_each(p, f)
+template <typename T>
+inline parser_each<T> each(std::istream &s, std::shared_ptr<parser<T>> p)
+{
+    return parser_each<T>(s, std::move(p), nullptr);
+}
+
+// each(s, p, q): range of the results from p's separated by q's, as sep_by_each(p, q, f)
+template <typename T, typename U>
+inline parser_each<T, U> each(
+    std::istream &s, std::shared_ptr<parser<T>> p, std::shared_ptr<parser<U>> q)
+{
+    return parser_each<T, U>(s, std::move(p), std::move(q));
+}
+
+
+
+template <typename T>
+class parser_alt : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const std::shared_ptr<parser<T>> q;
+
+public:
+    T operator()(std::istream &s) const override {
+	charge(s);
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	T t(p->operator()(s)); //or const T &t??
+	if ( !s.fail() )
+	    return t;
+	clear_weak(s);
+	    // recover failure, since the combined parser is not failed yet and now
+	    // depends on the second parser.
+	if ( f )
+	    f->rollback(m); // drop empty nodes from p
+	return q->operator()(s);
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::ALT, p.get(), q.get());
+    }
+
+    // alternatives(v): append the alternatives of the chain of "|" to v, in order
+    void alternatives(std::vector<std::shared_ptr<parser<T>>> &v) const {
+	for ( const std::shared_ptr<parser<T>> &r : { p, q } )
+	    if ( const parser_alt *const a = dynamic_cast<const parser_alt *>(r.get()) )
+		a->alternatives(v);
+	    else
+		v.push_back(r);
+    }
+
+    parser_alt(std::shared_ptr<parser<T>> p, std::shared_ptr<parser<T>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+template <>
+class parser_alt<void> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p;
+    const std::shared_ptr<parser<void>> q;
+
+public:
+    void operator()(std::istream &s) const override {
+	charge(s);
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	p->operator()(s);
+	if ( s.fail() ) {
+	    clear_weak(s);
+	    if ( f )
+		f->rollback(m); // drop empty nodes from p
+	    q->operator()(s);
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::ALT, p.get(), q.get());
+    }
+
+    // alternatives(v): append the alternatives of the chain of "|" to v, in order
+    void alternatives(std::vector<std::shared_ptr<parser<void>>> &v) const {
+	for ( const std::shared_ptr<parser<void>> &r : { p, q } )
+	    if ( const parser_alt *const a = dynamic_cast<const parser_alt *>(r.get()) )
+		a->alternatives(v);
+	    else
+		v.push_back(r);
+    }
+
+    parser_alt(std::shared_ptr<parser<void>> p, std::shared_ptr<parser<void>> q)
+    : p(std::move(p)), q(std::move(q)) {}
+};
+
+// "p | q": parse p first, and if p fails and consumes nothing parse q
+template <typename T>
+inline std::shared_ptr<parser<T>> operator|(
+    std::shared_ptr<parser<T>> p, std::shared_ptr<parser<T>> q)
+{
+    return share(std::shared_ptr<parser<T>>(new parser_alt<T>(
+	std::move(p), std::move(q) )));
+}
+
+
+
+template <typename T>
+class parser_try : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+
+public:
+    T operator()(std::istream &s) const override {
+	charge(s);
+	pos_stream::Pos saved_pos = pos(s);
+	std::streampos	tellg = s.tellg();
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	try {
+	    return p->operator()(s);
+	}
+	catch ( ParserError ) {
+	    if ( f )
+		f->rollback(m); // drop nodes from p
+	    if ( tellg != std::ios::pos_type(std::ios::off_type(-1)) ) {
+		// call seekg() only if enabled
+		if ( pos_stream::Budget *const b = budget(s) )
+		    b->rewind(pos(s).off - saved_pos.off); // bytes to read again
+		if ( trace_log *const t = trace(s) )
+		    t->record(trace_log::REWIND, "try_", pos(s).off, trace_log::OK,
+			saved_pos.off);
+		seek_back(s, tellg);
+		s.setstate(std::ios::failbit); // mark failure again
+		pos(s) = saved_pos;
+	    }
+	    return T(); // return the default value of T if failed
+	}
+    }
+
+    parser_node describe() const override {
+	return parser_node(parser_node::TRY, p.get());
+    }
+
+    parser_try(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
+};
+
+// try_(p): parse p, and backtrack the istream if "error failure" (but istream remains
+// marked as failure)
+template <typename T>
+inline std::shared_ptr<parser<T>> try_(std::shared_ptr<parser<T>> p)
+{
+    return share(std::shared_ptr<parser<T>>(new parser_try<T>( std::move(p) )));
+}
+
+
+
+// look_ahead(s, f): call f() to parse s speculatively, and then restore s to where it was
+// along with its pos, tree, errors and expected(s), returning whether f() has succeeded;
+// s is restored as well when f() throws BudgetExceeded or the like, which is passed on.
+// A failure of f() is not an error, but s is marked "error failure" if it does not
+// enable seekg().
+template <typename F>
+inline bool look_ahead(std::istream &s, const F &f)
+{
+    const pos_stream::Pos saved_pos = pos(s);
+    const std::streampos tellg = s.tellg();
+    if ( tellg == std::ios::pos_type(std::ios::off_type(-1)) ) {
+	s.setstate(std::ios::failbit);
+	throw ParserError(); // unable to restore s
+    }
+
+    // expected(s), the tree and the errors restored on leaving, and s rewound as well
+    // if left by an exception, for a caller catching it to go on parsing s
+    struct scope {
+	std::istream &s;
+	const pos_stream::Pos at;
+	const std::streampos g;
+	flat_tree *const t;
+	const flat_tree::mark m;
+	const std::size_t n;
+	expected_set *const e;
+	bool rewound;
+
+	scope(std::istream &s, const pos_stream::Pos &at, std::streampos g)
+	: s(s), at(at), g(g), t(tree(s)), m(t ? t->tell() : flat_tree::mark()),
+	  n(errors(s).size()), e(expected(s)), rewound(false) {
+	    expected(s) = nullptr; // failures looked ahead are not what was expected
+	}
+
+	~scope() {
+	    expected(s) = e;
+	    if ( t )
+		t->rollback(m); // nodes from what is not consumed
+	    errors(s).resize(n);
+	    if ( rewound )
+		return;
+	    try { // as well as it can while unwinding
+		s.clear();
+		s.seekg(g);
+	    }
+	    catch ( ... ) {
+	    }
+	    pos(s) = at;
+	}
+    } r(s, saved_pos, tellg);
+
+    bool ok;
+    try {
+	f();
+	ok = !s.fail();
+    }
+    catch ( ParserError ) {
+	ok = false;
+    }
+    if ( pos(s).off != saved_pos.off ) {
+	if ( pos_stream::Budget *const b = budget(s) )
+	    b->rewind(pos(s).off - saved_pos.off); // bytes to read again
+	if ( trace_log *const l = trace(s) )
+	    l->record(trace_log::REWIND, "look_ahead", pos(s).off, trace_log::OK,
+		saved_pos.off);
+    }
+    seek_back(s, tellg);
+    pos(s) = saved_pos;
+    r.rewound = true;
+    return ok;
+}
+
+template <typename T>
+class parser_followed_by : public parser<void> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const bool negated;
+
+    // how p is looked ahead: by peeking a character of cc, the end of input or lit from
+    // the get area, or by look_ahead() as a last resort
+    enum { GENERAL, CLASS, END, STR } how;
+    char_class cc;
+    const char *lit;
+
+    bool found(std::istream &s) const {
+	if ( how == CLASS ) {
+	    const int c = s.peek(); // may possibly set eofbit
+	    return c != EOF && cc.contains(char(c));
+	}
+	if ( how == END )
+	    return s.peek() == EOF;
+	if ( how == STR ) {
+	    const int c = s.peek();
+	    if ( c == EOF || char(c) != *lit )
+		return false;
+	    const std::size_t n = strlen(lit);
+	    if ( const char *b = static_cast<pos_stream *>(s.rdbuf())->ahead(n) )
+		return !memcmp(b, lit, n);
+	}
+	return look_ahead(s, [&] { p->operator()(s); });
+    }
+
+public:
+    void operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting p
+
+	if ( found(s) == negated )
+	    s.setstate(std::ios::failbit); // "weak failure" as nothing is consumed
+    }
+
+    parser_followed_by(std::shared_ptr<parser<T>> p, bool negated)
+    : p(std::move(p)), negated(negated), how(GENERAL), lit(0) {
+	parser_node n = parser_followed_by::p->describe();
+	while ( n.kind == parser_node::SKIP )
+	    n = n.p->describe();
+	if ( n.kind == parser_node::MATCH || (n.kind == parser_node::SPAN && n.min) )
+	    how = CLASS, cc = n.cc; // as much as its first character
+	else if ( n.kind == parser_node::END )
+	    how = END;
+	else if ( n.kind == parser_node::STR && *n.s )
+	    how = STR, lit = n.s;
+    }
+};
+
+// followed_by(p): succeed if p would succeed here, consuming nothing either way; a
+// character class, eof() or a literal is only peeked at, and other parsers are run and
+// rewound without throwing, which needs seekg() enabled.
+template <typename T>
+inline std::shared_ptr<parser<void>> followed_by(std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<void>>(
+	new parser_followed_by<T>( std::move(p), false ));
+}
+
+// not_followed_by(p): succeed if p would fail here, consuming nothing either way; e.g.,
+// skip("if") > not_followed_by(alphanum()) for the keyword if, peeking a character.
+template <typename T>
+inline std::shared_ptr<parser<void>> not_followed_by(std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<void>>(
+	new parser_followed_by<T>( std::move(p), true ));
+}
+
+template <typename T>
+class parser_peek : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+
+public:
+    T operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting p
+
+	T t = T();
+	if ( !look_ahead(s, [&] { t = p->operator()(s); }) ) {
+	    s.setstate(std::ios::failbit);
+	    return T();
+	}
+	return t;
+    }
+
+    parser_peek(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
+};
+
+class parser_peek_match : public parser<char> {
+protected:
+    const char_class cc;
+
+public:
+    char operator()(std::istream &s) const override {
+	if ( s.fail() )
+	    throw ParserError(); // expecting cc
+
+	const int c = s.peek();
+	if ( c == EOF || !cc.contains(char(c)) ) {
+	    s.setstate(std::ios::failbit);
+	    return char();
+	}
+	return char(c);
+    }
+
+    parser_peek_match(const char_class &cc) : cc(cc) {}
+};
+
+// peek(p): parse p and return its result, but consume nothing; fails weakly if p fails
+template <typename T>
+inline std::shared_ptr<parser<T>> peek(std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<T>>(new parser_peek<T>( std::move(p) ));
+}
+
+// peek(p) of a void parser is followed_by(p)
+inline std::shared_ptr<parser<void>> peek(std::shared_ptr<parser<void>> p)
+{
+    return followed_by(std::move(p));
+}
+
+// peek(p) of a character parser only peeks at a character
+inline std::shared_ptr<parser<char>> peek(std::shared_ptr<parser<char>> p)
+{
+    const parser_node n = p->describe();
+    if ( n.kind == parser_node::MATCH )
+	return std::shared_ptr<parser<char>>(new parser_peek_match( n.cc ));
+    return std::shared_ptr<parser<char>>(new parser_peek<char>( std::move(p) ));
+}
+
+
+
+#include <stdexcept> // for std::logic_error
+
+class parser_intern : public parser<std::uint32_t> {
+protected:
+    const std::shared_ptr<parser<std::string>> p;
+    symbol_table *const table; // shared, or nullptr for symbols(s)
+
+    // p scanned as a character of head (if one) followed by characters of tail (at
+    // least one if more), if so, where rest is the parser of tail after head
+    bool fast, one, more;
+    char_class head, tail;
+    const parser_base *rest;
+
+    // the characters matched by a character parser p, if so
+    static bool chars(const parser_base *p, char_class &cc) {
+	const parser_node n = p->describe();
+	char_class a, b;
+	if ( n.kind == parser_node::MATCH )
+	    return cc = n.cc, true;
+	if ( n.kind == parser_node::MAP && !n.action )
+	    return chars(n.p, cc);
+	if ( n.kind == parser_node::ALT && chars(n.p, a) && chars(n.q, b) )
+	    return cc = a | b, true;
+	return false;
+    }
+
+    // the characters repeated by a span parser or many(), if so, and whether at least
+    // one is required
+    static bool run(const parser_base *p, char_class &cc, bool &one) {
+	const parser_node n = p->describe();
+	one = n.kind == parser_node::SPAN && n.min;
+	if ( n.kind == parser_node::SPAN )
+	    return cc = n.cc, true;
+	return n.kind == parser_node::MANY && chars(n.p, cc);
+    }
+
+public:
+    std::uint32_t operator()(std::istream &s) const override {
+	symbol_table *const t = table ? table : symbols(s);
+	if ( !t ) // a mistake in the program rather than in the input
+	    throw std::logic_error("intern(p) without symbols(s) set");
+	if ( s.fail() )
+	    throw ParserError(); // expecting p
+
+	if ( !fast ) {
+	    std::string name(p->operator()(s));
+	    const std::uint32_t i = s.fail() ? 0 : t->id(name);
+	    recycle(s, std::move(name));
+	    return i;
+	}
+	static thread_local std::string name; // keeping its capacity
+	name.clear();
+	pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+	if ( one ) {
+	    const int x = ps->sgetc();
+	    if ( x == EOF || !head.contains(char(x)) ) {
+		s.setstate(std::ios::failbit); // "weak failure"
+		expect(s, p.get());
+		return 0;
+	    }
+	    ps->sbumpc();
+	    ps->pos.update(ps->c = char(x));
+	    name.push_back(char(x));
+	}
+	if ( !ps->scan(tail, &name) && more ) { // from the get area in bulk
+	    s.setstate(std::ios::failbit);
+	    expect(s, rest);
+	    throw ParserError(); // "error failure" after the head
+	}
+	return t->id(name.data(), name.size());
+    }
+
+    parser_intern(std::shared_ptr<parser<std::string>> p, symbol_table *table)
+    : p(std::move(p)), table(table), fast(false), one(false), more(false),
+      rest(nullptr) {
+	const parser_node n = parser_intern::p->describe();
+	if ( run(parser_intern::p.get(), tail, one) )
+	    fast = true, head = tail;
+	else if ( n.kind == parser_node::CAT && chars(n.p, head) && run(n.q, tail, more) )
+	    fast = one = true, rest = n.q;
+    }
+};
+
+// intern(p): parse a name with the string parser p, and return its id in symbols(s),
+// allocating only for a name seen for the first time; a span parser, or a character
+// parser followed by many() of another or a span parser, such as
+// (chr('_') | letter()) + many(chr('_') | alphanum()), is scanned from the input in
+// bulk without calling p. symbols(s) must be set, or std::logic_error is thrown.
+inline std::shared_ptr<parser<std::uint32_t>> intern(
+    std::shared_ptr<parser<std::string>> p)
+{
+    return std::shared_ptr<parser<std::uint32_t>>(new parser_intern(
+	std::move(p), nullptr ));
+}
+
+// intern(p, t): intern(p) into a symbol_table t shared by the streams parsed, which
+// needs to be constructed shared if they are parsed in parallel
+inline std::shared_ptr<parser<std::uint32_t>> intern(
+    std::shared_ptr<parser<std::string>> p, symbol_table &t)
+{
+    return std::shared_ptr<parser<std::uint32_t>>(new parser_intern( std::move(p), &t ));
+}
+
+
+
+template <typename T>
+class parser_recover : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+    const char_class skip; // characters to skip before resynchronizing
+    const char *const rule;
+
+public:
+    T operator()(std::istream &s) const override {
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	MARK;
+	try {
+	    return p->operator()(s);
+	}
+	catch ( ParserError ) {
+	    if ( f )
+		f->rollback(m); // drop nodes from p
+	    pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+	    pos_stream::Error e = { ps->pos, rule, std::string() };
+	    if ( expected_set *const x = ps->expected ) {
+		e.expected = x->message();
+		x->reset(); // not to merge the failures of the next record in
+	    }
+	    ps->errors.push_back(std::move(e));
+
+	    clear_weak(s);
+	    ps->scan(skip); // skip ahead in bulk
+	    if ( s.peek() != EOF ) { // may possibly set eofbit
+		s.ignore(); // consume the sync character
+		update_pos(s);
+	    }
+	    if ( !tellg(s, _off) ) // at eof with nothing consumed: a success would
+		s.setstate(std::ios::failbit); // let many() repeat forever
+	    return T(); // return the default value of T as if succeeded
+	}
+	// "weak failure" is not recovered but returned as is, so that p can still be an
+	// alternative in p | q and many(recover(p, sync)) can stop at the end of input.
+    }
+
+    parser_recover(std::shared_ptr<parser<T>> p, const char_class &sync, const char *rule)
+    : p(std::move(p)), skip(~sync), rule(rule) {}
+};
+
+// recover(p, cc, "rule"): parse p, and if "error failure" log the error in errors(s),
+// skip past the next character of cc (or to eof) and succeed with the default value,
+// or fail weakly if nothing was consumed at all (at eof); e.g.,
+// many(recover(record, "\n")) reports every bad record in one pass.
+template <typename T>
+inline std::shared_ptr<parser<T>> recover(
+    std::shared_ptr<parser<T>> p, const char_class &sync, const char *rule =0)
+{
+    return std::shared_ptr<parser<T>>(new parser_recover<T>( std::move(p), sync, rule ));
+}
+
+
+
+template <typename T>
+class parser_tag : public parser<T> {
+protected:
+    const std::uint32_t k; // node kind
+    const std::shared_ptr<parser<T>> p;
+
+    // node opened on construction, and closed on destruction or discarded with its
+    // descendants if p has failed (or thrown)
+    struct scope {
+	std::istream &s;
+	flat_tree &f;
+	const flat_tree::mark m;
+	const std::uint32_t i;
+
+	scope(std::istream &s, flat_tree &f, std::uint32_t k)
+	: s(s), f(f), m(f.tell()), i(f.begin(k, std::uint64_t(tellg(s, 0)))) {}
+
+	~scope() {
+	    if ( s.fail() )
+		f.rollback(m);
+	    else
+		f.end(i, m, std::uint64_t(tellg(s, 0)));
+	}
+    };
+
+public:
+    T operator()(std::istream &s) const override {
+	flat_tree *const f = tree(s);
+	if ( !f )
+	    return p->operator()(s); // no tree to build
+	const scope n(s, *f, k);
+	return p->operator()(s);
+    }
+
+    parser_tag(std::uint32_t k, std::shared_ptr<parser<T>> p) : k(k), p(std::move(p)) {}
+};
+
+// tag(k, p): parse p, emitting a node of kind k spanning the input consumed by p into
+// tree(s) if set, with the nodes emitted by p as its children; e.g.,
+//	flat_tree t; tree(s) = &t; s >> many(tag(ITEM, item));
+template <typename T>
+inline std::shared_ptr<parser<T>> tag(std::uint32_t k, std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<T>>(new parser_tag<T>( k, std::move(p) ));
+}
+
+
+
+#include <exception> // for std::uncaught_exception()
+
+template <typename T>
+class parser_traced : public parser<T> {
+protected:
+    const char *const name;
+    const std::shared_ptr<parser<T>> p;
+
+    // ENTER recorded on construction, and EXIT on destruction with the outcome of p
+    struct scope {
+	std::istream &s;
+	trace_log &t;
+	const char *const name;
+	const int uncaught;
+
+	// number of exceptions being thrown, for telling whether it is destroyed by
+	// unwinding
+	static int exceptions() {
+#if __cplusplus >= 201703L
+	    return std::uncaught_exceptions();
+#else
+	    return std::uncaught_exception();
+#endif
+	}
+
+	scope(std::istream &s, trace_log &t, const char *name)
+	: s(s), t(t), name(name), uncaught(exceptions()) {
+	    t.record(trace_log::ENTER, name, std::uint64_t(tellg(s, 0)));
+	}
+
+	~scope() {
+	    t.record(trace_log::EXIT, name, std::uint64_t(tellg(s, 0)),
+		exceptions() > uncaught ? trace_log::ERROR
+		: s.fail() ? trace_log::WEAK : trace_log::OK);
+	}
+    };
+
+public:
+    T operator()(std::istream &s) const override {
+	trace_log *const t = trace(s);
+	if ( !t )
+	    return p->operator()(s); // not traced
+	const scope n(s, *t, name);
+	return p->operator()(s);
+    }
+
+    parser_traced(const char *name, std::shared_ptr<parser<T>> p)
+    : name(name), p(std::move(p)) {}
+};
+
+// traced("name", p): parse p as the rule "name", recording its entry and exit into
+// trace(s) if set; e.g.,
+//	trace_log l; trace(s) = &l; s >> traced("value", value); l.write_chrome(o);
+template <typename T>
+inline std::shared_ptr<parser<T>> traced(const char *name, std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<T>>(new parser_traced<T>( name, std::move(p) ));
+}
+
+
+
+#include <map> // for std::map
+
+// dfa is a table-driven deterministic automaton compiled from a regular combinator graph,
+// i.e., from character parsers, skip(), eof(), span parsers, "+", ">", many(), many1(),
+// sep_by(), sep_by1() and "|" without semantic actions nor try_(). Because parsers here
+// decide on a single peeked character and never backtrack, the state of such a graph is
+// just where it is in each combinator and whether each combinator has consumed since it
+// began, so the dfa is built by running the combinators symbolically on every character
+// and it reproduces the parsers exactly, including "weak failure" and "error failure".
+class dfa {
+public:
+    enum { ACCEPT = -1, WEAK = -2, ERROR = -3 }; // actions other than going to a state
+
+protected:
+    // regular expression converted from a parser_node
+    struct re {
+	enum kind_t { CLASS, STR, END, SEQ, ALT, STAR, PLUS, SEP_BY, SEP_BY1 } kind;
+	char_class cc; // CLASS
+	const char *s; // STR
+	int a, b; // operands
+	bool keep; // whether the matched characters make up the result
+    };
+    std::vector<re> res;
+
+    struct frame {
+	int node, stage;
+	bool consumed; // since the combinator began
+    };
+
+    int cls[257]; // equivalence class of each character and EOF(256)
+    int ncls;
+    std::vector<int> table; // table[state * ncls + cls]: (next << 1 | keep) or an action
+    std::vector<std::shared_ptr<parser_base>> expects; // [state * 2 + end], see compile()
+
+    enum { CONSUME = 1, LOOP = -4, MAX_STATES = 4096 };
+
+    int convert(const parser_base *p, bool keep,
+	std::map<std::pair<const parser_base *, bool>, int> &memo, int depth)
+    {
+	if ( depth > 256 )
+	    return -1;
+	const std::pair<const parser_base *, bool> key(p, keep);
+	const std::map<std::pair<const parser_base *, bool>, int>::iterator it =
+	    memo.find(key);
+	if ( it != memo.end() )
+	    return it->second;
+
+	const std::type_info &t = p->result_type();
+	keep = keep && t != typeid(void);
+	if ( keep && t != typeid(char) && t != typeid(std::string) )
+	    return -1; // result other than characters
+
+	const parser_node n = p->describe();
+	re r = { re::CLASS, n.cc, n.s, -1, -1, keep };
+	switch ( n.kind ) {
+	case parser_node::MATCH:
+	    break;
+	case parser_node::STR:
+	    r.kind = re::STR;
+	    break;
+	case parser_node::END:
+	    r.kind = re::END;
+	    break;
+	case parser_node::SPAN:
+	    res.push_back(r);
+	    r.kind = n.min ? re::PLUS : re::STAR;
+	    r.a = int(res.size()) - 1;
+	    break;
+	case parser_node::SKIP:
+	    return convert(n.p, false, memo, depth + 1);
+	case parser_node::MAP:
+	    return n.action ? -1 : convert(n.p, keep, memo, depth + 1);
+	case parser_node::CAT:
+	case parser_node::SEQ:
+	case parser_node::ALT:
+	case parser_node::SEP_BY:
+	case parser_node::SEP_BY1: {
+	    if ( n.kind == parser_node::SEP_BY1 && keep )
+		return -1; // with a combiner, as in bytecode and share_key()
+	    bool keep_p = keep, keep_q = keep;
+	    if ( n.kind == parser_node::SEQ ) // result from q, or from p if q is void
+		keep_p = keep && n.q->result_type() == typeid(void);
+	    else if ( n.kind == parser_node::SEP_BY || n.kind == parser_node::SEP_BY1 )
+		keep_q = false; // separator
+	    r.kind = n.kind == parser_node::ALT ? re::ALT
+		: n.kind == parser_node::SEP_BY ? re::SEP_BY
+		: n.kind == parser_node::SEP_BY1 ? re::SEP_BY1 : re::SEQ;
+	    if ( (r.a = convert(n.p, keep_p, memo, depth + 1)) < 0
+		|| (r.b = convert(n.q, keep_q, memo, depth + 1)) < 0 )
+		return -1;
+	    break;
+	}
+	case parser_node::MANY:
+	case parser_node::MANY1:
+	    if ( n.kind == parser_node::MANY1 && keep )
+		return -1; // with a combiner
+	    r.kind = n.kind == parser_node::MANY ? re::STAR : re::PLUS;
+	    if ( (r.a = convert(n.p, keep, memo, depth + 1)) < 0 )
+		return -1;
+	    break;
+	default: // not regular
+	    return -1;
+	}
+	res.push_back(r);
+	return memo[key] = int(res.size()) - 1;
+    }
+
+    // run the combinators in k (or the root if start) on peeking x until x is consumed,
+    // leaving k as they are right after consuming x, or until the result is decided.
+    int step(std::vector<frame> &k, bool start, int x, bool &keep) const {
+	int call = start ? int(res.size()) - 1 : -1; // re to call, or -1 to return ok
+	bool ok = true;
+	for ( std::size_t n = 0 ; n < 64 + 16 * res.size() ; n++ ) {
+	    if ( call >= 0 ) {
+		const re &r = res[call];
+		const frame f = { call, 0, false };
+		switch ( r.kind ) {
+		case re::CLASS:
+		    if ( x != 256 && r.cc.contains(char(x)) )
+			return keep = r.keep, CONSUME;
+		    ok = false, call = -1;
+		    break;
+		case re::END:
+		    ok = x == 256, call = -1;
+		    break;
+		case re::STR: // resumed below
+		    k.push_back(f);
+		    ok = true, call = -1;
+		    break;
+		default:
+		    k.push_back(f);
+		    call = r.a;
+		}
+		continue;
+	    }
+
+	    if ( k.empty() )
+		return ok ? ACCEPT : start ? WEAK : ERROR;
+	    frame &f = k.back();
+	    const re &r = res[f.node];
+	    switch ( r.kind ) {
+	    case re::STR:
+		if ( !r.s[f.stage] )
+		    k.pop_back();
+		else if ( x == (unsigned char)r.s[f.stage] )
+		    return f.stage++, keep = false, CONSUME;
+		else if ( f.consumed )
+		    return ERROR;
+		else
+		    k.pop_back(), ok = false;
+		break;
+	    case re::SEQ:
+		if ( f.stage == 0 && ok )
+		    f.stage = 1, call = r.b;
+		else if ( !ok && f.consumed )
+		    return ERROR;
+		else
+		    k.pop_back();
+		break;
+	    case re::ALT:
+		if ( f.stage == 0 && !ok )
+		    f.stage = 1, call = r.b;
+		else
+		    k.pop_back();
+		break;
+	    case re::STAR:
+	    case re::PLUS:
+		if ( ok )
+		    f.stage = 1, call = r.a;
+		else
+		    ok = r.kind == re::STAR || f.stage, k.pop_back();
+		break;
+	    default: // SEP_BY, SEP_BY1
+		if ( ok )
+		    f.stage = f.stage == 1 ? 2 : 1, call = f.stage == 1 ? r.b : r.a;
+		else if ( f.stage == 2 && f.consumed )
+		    return ERROR;
+		else
+		    ok = f.stage == 1 || (f.stage == 0 && r.kind == re::SEP_BY),
+		    k.pop_back();
+	    }
+	}
+	return LOOP; // a loop of combinators consuming nothing, e.g. many(many(p))
+    }
+
+public:
+    // compile p; returns false if p is not regular
+    bool compile(const parser_base &p) {
+	std::map<std::pair<const parser_base *, bool>, int> memo;
+	if ( convert(&p, true, memo, 0) < 0 )
+	    return false;
+
+	// build states, where state 0 is the start state
+	std::vector<std::vector<frame> > states(1);
+	std::map<std::vector<int>, int> ids;
+	std::vector<int> raw; // raw[state * 257 + x]
+	for ( std::size_t i = 0 ; i < states.size() ; i++ )
+	    for ( int x = 0 ; x < 257 ; x++ ) {
+		std::vector<frame> k(states[i]);
+		bool keep = false;
+		const int a = step(k, i == 0, x, keep);
+		if ( a == LOOP )
+		    return false;
+		if ( a != CONSUME ) {
+		    raw.push_back(a);
+		    continue;
+		}
+
+		std::vector<int> id;
+		for ( std::size_t j = 0 ; j < k.size() ; j++ ) {
+		    k[j].consumed = true;
+		    id.push_back(k[j].node), id.push_back(k[j].stage);
+		}
+		const std::map<std::vector<int>, int>::iterator it = ids.find(id);
+		int next;
+		if ( it != ids.end() )
+		    next = it->second;
+		else {
+		    if ( states.size() == MAX_STATES )
+			return false;
+		    ids[id] = next = int(states.size());
+		    states.push_back(k);
+		}
+		raw.push_back(next << 1 | keep);
+	    }
+
+	// minimize the states by refining the partition of the states by their actions
+	const int n = int(states.size());
+	std::vector<int> block(n, 0);
+	int nblocks = 1;
+	for ( ;; ) {
+	    std::map<std::vector<int>, int> sigs;
+	    std::vector<int> next_block(n);
+	    for ( int i = 0 ; i < n ; i++ ) {
+		std::vector<int> sig(1, block[i]);
+		for ( int x = 0 ; x < 257 ; x++ ) {
+		    const int a = raw[i * 257 + x];
+		    sig.push_back(a < 0 ? a : block[a >> 1] << 1 | (a & 1));
+		}
+		const int id = int(sigs.size());
+		next_block[i] = sigs.insert(std::make_pair(sig, id)).first->second;
+		    // state 0 always remains in block 0
+	    }
+	    block.swap(next_block);
+	    if ( int(sigs.size()) == nblocks )
+		break;
+	    nblocks = int(sigs.size());
+	}
+
+	// merge the characters that act the same in every state into a class
+	std::map<std::vector<int>, int> columns;
+	for ( int x = 0 ; x < 257 ; x++ ) {
+	    std::vector<int> column(nblocks);
+	    for ( int i = 0 ; i < n ; i++ ) {
+		const int a = raw[i * 257 + x];
+		column[block[i]] = a < 0 ? a : block[a >> 1] << 1 | (a & 1);
+	    }
+	    const int id = int(columns.size());
+	    cls[x] = columns.insert(std::make_pair(column, id)).first->second;
+	}
+	ncls = int(columns.size());
+	table.assign(nblocks * ncls, 0);
+	for ( std::map<std::vector<int>, int>::iterator it = columns.begin() ;
+	    it != columns.end() ; ++it )
+	    for ( int i = 0 ; i < nblocks ; i++ )
+		table[i * ncls + it->second] = it->first[i];
+
+	// what a state raising an "error failure" expected, for expected(s): the
+	// characters it consumes other than those staying there, as a span that has
+	// matched is not what failed (or all of them if none), and the end of input if
+	// accepted there
+	expects.assign(2 * nblocks, nullptr);
+	for ( int i = 0 ; i < nblocks ; i++ ) {
+	    char_class cc, more;
+	    bool error = false;
+	    for ( int x = 0 ; x < 257 ; x++ ) {
+		const int a = table[i * ncls + cls[x]];
+		error = error || a == ERROR;
+		if ( x < 256 && a >= 0 )
+		    (a >> 1 == i ? more : cc).insert(char(x));
+	    }
+	    if ( cc.empty() )
+		cc = more;
+	    if ( error && !cc.empty() )
+		expects[2 * i] = take_while1(cc);
+	    if ( error && table[i * ncls + cls[256]] == ACCEPT )
+		expects[2 * i + 1] = eof();
+	}
+	return true;
+    }
+
+    int states() const { return int(table.size()) / ncls; }
+
+    // for pos_stream::scan(), running the dfa from *state while it consumes characters
+    // and passing the characters making up the result to out
+    template <class Out>
+    struct runner {
+	const dfa &d;
+	int &state;
+	Out &out;
+
+	const char *operator()(const char *b, const char *e) const {
+	    for ( ; b != e ; b++ ) {
+		const int a = d.table[state * d.ncls + d.cls[(unsigned char)*b]];
+		if ( a < 0 )
+		    break;
+		if ( a & 1 )
+		    out(*b);
+		state = a >> 1;
+	    }
+	    return b;
+	}
+    };
+
+    // run the dfa on s, returning ACCEPT or WEAK, or throwing ParserError
+    template <class Out>
+    int run(std::istream &s, Out &out) const {
+	if ( s.fail() )
+	    throw ParserError();
+
+	int state = 0;
+	const runner<Out> r = { *this, state, out };
+	static_cast<pos_stream *>(s.rdbuf())->scan(r);
+	const int x = s.peek(); // may possibly set eofbit
+	const int a = table[state * ncls + cls[x == EOF ? 256 : (unsigned char)x]];
+	if ( a == ERROR ) {
+	    for ( int end = 0 ; end < 2 ; end++ )
+		if ( const parser_base *const p = expects[2 * state + end].get() )
+		    expect(s, p);
+	    throw ParserError();
+	}
+	if ( a == WEAK )
+	    s.setstate(std::ios::failbit); // mark failure
+	return a;
+    }
+};
+
+// result builders for dfa::run()
+struct dfa_void {
+    void operator()(char) {}
+};
+
+struct dfa_char {
+    char c;
+    void operator()(char c) { dfa_char::c = c; }
+};
+
+struct dfa_string {
+    std::string t;
+    void operator()(char c) { t.push_back(c); }
+};
+
+template <typename T>
+// T is std::string, char or void
+class parser_dfa : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p; // the parser compiled, for describe()
+    dfa d;
+
+public:
+    T operator()(std::istream &s) const override {
+	dfa_string r;
+	if ( d.run(s, r) != dfa::ACCEPT )
+	    expect(s, this);
+	return r.t; // "" if failed
+    }
+
+    parser_node describe() const override { return p->describe(); }
+
+    parser_dfa(std::shared_ptr<parser<T>> p, const dfa &d) : p(std::move(p)), d(d) {}
+};
+
+template <>
+inline char parser_dfa<char>::operator()(std::istream &s) const
+{
+    dfa_char r = { char() };
+    if ( d.run(s, r) == dfa::ACCEPT )
+	return r.c;
+    expect(s, this);
+    return char();
+}
+
+template <>
+inline void parser_dfa<void>::operator()(std::istream &s) const
+{
+    dfa_void r;
+    if ( d.run(s, r) != dfa::ACCEPT )
+	expect(s, this);
+}
+
+// compile_regular(p): compile p into a dfa if p is regular, or return p itself otherwise
+template <typename T>
+inline std::shared_ptr<parser<T>> compile_regular(std::shared_ptr<parser<T>> p)
+{
+    return p; // results other than characters are never regular
+}
+
+template <typename T>
+inline std::shared_ptr<parser<T>> compile_regular_(std::shared_ptr<parser<T>> p)
+{
+    dfa d;
+    if ( !d.compile(*p) )
+	return p;
+    return std::shared_ptr<parser<T>>(new parser_dfa<T>( std::move(p), d ));
+}
+
+inline std::shared_ptr<parser<std::string>> compile_regular(
+    std::shared_ptr<parser<std::string>> p)
+{
+    return compile_regular_(std::move(p));
+}
+
+inline std::shared_ptr<parser<char>> compile_regular(std::shared_ptr<parser<char>> p)
+{
+    return compile_regular_(std::move(p));
+}
+
+inline std::shared_ptr<parser<void>> compile_regular(std::shared_ptr<parser<void>> p)
+{
+    return compile_regular_(std::move(p));
+}
+
+
+
+// bytecode is a linear program for a parsing machine compiled from a combinator graph,
+// after LPeg's (Roberto Ierusalimschy, "A Text Pattern-Matching Tool based on Parsing
+// Expression Grammars"), so that a grammar runs in one loop instead of virtual calls
+// through the graph. It takes the same parsers as dfa but without state explosion and
+// with try_(), and shares each subparser used more than once as a subroutine. The
+// machine keeps an explicit stack of entries: a choice resumes at its target if what
+// follows fails weakly, a guard turns a weak failure into an "error failure" once
+// anything has been consumed since it (as MARK and CHECK do), a try entry rewinds the
+// input on an "error failure", and a call returns. write() and read() dump and load a
+// program so that a large grammar need not be rebuilt at startup.
+class bytecode {
+public:
+    enum { ACCEPT = -1, WEAK = -2 }; // results of run()
+
+    enum op_t {
+	CHAR, // consume a character of classes[a], or fail
+	SPAN, // consume the characters of classes[a]
+	SPAN1, // consume one or more characters of classes[a], or fail
+	STR, // consume the literal at lits[a], or fail (after its first character, error)
+	END, // fail unless at eof
+	CHOICE, // push a choice resuming at a
+	COMMIT, // pop a choice (or a call) and jump to a
+	GUARD, // push a guard
+	TRY, // push a try entry
+	DROP, // pop a guard or a try entry
+	JUMP, // jump to a
+	CALL, // push a call and jump to a
+	RET, // pop a call and return
+	HALT // accept
+    };
+
+    struct instr {
+	std::uint8_t op;
+	std::uint8_t keep; // whether the characters consumed make up the result
+	std::uint16_t unused;
+	std::int32_t a; // operand
+    };
+
+    std::vector<instr> code;
+    std::vector<char_class> classes;
+    std::string lits; // literals, each terminated by '\0'
+    char type; // result type; 'v' for void, 'c' for char and 's' for std::string
+
+protected:
+    // parsers noted into expected(s) where each instruction fails, the literals among
+    // them pointing into a copy of lits shared by the copies of the program
+    std::vector<std::shared_ptr<parser_base>> expects;
+    std::shared_ptr<const std::string> noted;
+
+    // entry of the stack of the machine
+    struct entry {
+	int op; // CHOICE, GUARD, TRY or CALL
+	int pc; // to resume or return at
+	std::size_t len; // length of the result so far, for TRY
+	pos_stream::Pos pos; // where the entry was pushed, for GUARD and TRY
+	std::streampos g; // tellg() for TRY
+    };
+
+    int add(int op, bool keep =false, int a =0) {
+	const instr i = { std::uint8_t(op), std::uint8_t(keep), 0, std::int32_t(a) };
+	code.push_back(i);
+	return int(code.size()) - 1;
+    }
+
+    int add(const char_class &cc, std::map<std::string, int> &ids) {
+	std::string k; // the 256 bits of cc as the key
+	for ( int c = 0 ; c < 256 ; c += 8 ) {
+	    char b = 0;
+	    for ( int i = 0 ; i < 8 ; i++ )
+		b |= char(cc.contains(char(c + i)) << i);
+	    k.push_back(b);
+	}
+	const std::map<std::string, int>::iterator it = ids.find(k);
+	if ( it != ids.end() )
+	    return it->second;
+	classes.push_back(cc);
+	return ids[k] = int(classes.size()) - 1;
+    }
+
+    // state of compile()
+    struct builder {
+	std::map<const parser_base *, int> refs; // number of references to each node
+	std::map<std::pair<const parser_base *, bool>, int> subs; // subroutines
+	std::vector<std::pair<int, std::pair<const parser_base *, bool>>> calls;
+	std::map<std::string, int> classes, lits;
+    };
+
+    static bool leaf(const parser_node &n) {
+	return n.kind == parser_node::MATCH || n.kind == parser_node::STR
+	    || n.kind == parser_node::END || n.kind == parser_node::SPAN;
+    }
+
+    static void count(const parser_base *p, builder &b, int depth) {
+	if ( depth > 256 || b.refs[p]++ )
+	    return;
+	const parser_node n = p->describe();
+	if ( n.p )
+	    count(n.p, b, depth + 1);
+	if ( n.q )
+	    count(n.q, b, depth + 1);
+	if ( n.p && (n.kind == parser_node::MANY1 || n.kind == parser_node::SEP_BY1) )
+	    b.refs[n.p]++; // p is emitted twice, or called from the loop
+    }
+
+    // emit p inline, or a call to the subroutine of p if p is used more than once
+    bool sub(const parser_base *p, bool keep, builder &b, int depth) {
+	if ( b.refs[p] < 2 || leaf(p->describe()) )
+	    return emit(p, keep, b, depth);
+	b.calls.push_back(std::make_pair(add(CALL), std::make_pair(p, keep)));
+	return true;
+    }
+
+    bool emit(const parser_base *p, bool keep, builder &b, int depth) {
+	if ( depth > 256 )
+	    return false;
+	const std::type_info &t = p->result_type();
+	keep = keep && t != typeid(void);
+	if ( keep && t != typeid(char) && t != typeid(std::string) )
+	    return false; // result other than characters
+
+	const parser_node n = p->describe();
+	switch ( n.kind ) {
+	case parser_node::MATCH:
+	    add(CHAR, keep, add(n.cc, b.classes));
+	    return true;
+	case parser_node::STR: {
+	    const std::map<std::string, int>::iterator it = b.lits.find(n.s);
+	    int a = it != b.lits.end() ? it->second : int(lits.size());
+	    if ( it == b.lits.end() )
+		b.lits[n.s] = a, lits.append(n.s), lits.push_back('\0');
+	    add(STR, false, a);
+	    return true;
+	}
+	case parser_node::END:
+	    add(END);
+	    return true;
+	case parser_node::SPAN:
+	    add(n.min ? SPAN1 : SPAN, keep, add(n.cc, b.classes));
+	    return true;
+	case parser_node::SKIP:
+	    return sub(n.p, false, b, depth + 1);
+	case parser_node::MAP:
+	    return !n.action && sub(n.p, keep, b, depth + 1);
+	case parser_node::CAT:
+	case parser_node::SEQ: {
+	    bool keep_p = keep; // result from q, or from p if q is void
+	    if ( n.kind == parser_node::SEQ )
+		keep_p = keep && n.q->result_type() == typeid(void);
+	    add(GUARD);
+	    if ( !sub(n.p, keep_p, b, depth + 1) || !sub(n.q, keep, b, depth + 1) )
+		return false;
+	    add(DROP);
+	    return true;
+	}
+	case parser_node::ALT: {
+	    const int c = add(CHOICE);
+	    if ( !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    const int j = add(COMMIT);
+	    code[c].a = int(code.size());
+	    if ( !sub(n.q, keep, b, depth + 1) )
+		return false;
+	    code[j].a = int(code.size());
+	    return true;
+	}
+	case parser_node::MANY:
+	case parser_node::MANY1: {
+	    if ( n.kind == parser_node::MANY1 && keep )
+		return false; // with a combiner
+	    const parser_node m = n.p->describe();
+	    if ( m.kind == parser_node::MATCH ) { // as take_while(cc)
+		add(n.kind == parser_node::MANY ? SPAN : SPAN1, keep,
+		    add(m.cc, b.classes));
+		return true;
+	    }
+	    if ( n.kind == parser_node::MANY1 && !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    const int c = add(CHOICE);
+	    if ( !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    add(COMMIT, false, c);
+	    code[c].a = int(code.size());
+	    return true;
+	}
+	case parser_node::SEP_BY: {
+	    add(GUARD);
+	    const int c = add(CHOICE);
+	    if ( !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    add(COMMIT, false, int(code.size()) + 1);
+	    const int l = add(CHOICE);
+	    if ( !sub(n.q, false, b, depth + 1) )
+		return false;
+	    add(COMMIT, false, int(code.size()) + 1);
+	    if ( !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    add(JUMP, false, l);
+	    code[c].a = code[l].a = int(code.size());
+	    add(DROP);
+	    return true;
+	}
+	case parser_node::SEP_BY1: {
+	    if ( keep )
+		return false; // with a combiner
+	    add(GUARD);
+	    const int l = int(code.size());
+	    if ( !sub(n.p, false, b, depth + 1) )
+		return false;
+	    const int c = add(CHOICE);
+	    if ( !sub(n.q, false, b, depth + 1) )
+		return false;
+	    add(COMMIT, false, l);
+	    code[c].a = int(code.size());
+	    add(DROP);
+	    return true;
+	}
+	case parser_node::TRY:
+	    add(TRY);
+	    if ( !sub(n.p, keep, b, depth + 1) )
+		return false;
+	    add(DROP);
+	    return true;
+	default: // OPAQUE, or with semantic actions
+	    return false;
+	}
+    }
+
+    void expectations() {
+	const std::shared_ptr<const std::string> l(new std::string(lits));
+	expects.assign(code.size(), nullptr);
+	for ( std::size_t i = 0 ; i < code.size() ; i++ )
+	    if ( code[i].op == CHAR || code[i].op == SPAN1 )
+		expects[i] = take_while1(classes[code[i].a]);
+	    else if ( code[i].op == STR )
+		expects[i] = std::shared_ptr<parser_base>(
+		    new parser_str( l->data() + code[i].a ));
+	    else if ( code[i].op == END )
+		expects[i] = eof();
+	noted = l;
+    }
+
+    // note that instruction pc failed at at into expected(s), if set
+    void note(std::istream &s, int pc, const pos_stream::Pos &at) const {
+	if ( expected_set *const e = expected(s) )
+	    e->fail(at, expects[pc].get());
+    }
+
+    // unwind k on a weak failure to the choice to resume at, or return -1 for the
+    // failure of the whole program; a guard that has consumed raises an error instead
+    int fail(std::istream &s, std::vector<entry> &k, std::string &t) const {
+	const std::streamoff off = pos(s).off;
+	for ( ; !k.empty() ; k.pop_back() ) {
+	    const entry &e = k.back();
+	    if ( e.op == CHOICE ) {
+		const int pc = e.pc;
+		k.pop_back();
+		return pc;
+	    }
+	    if ( e.op == GUARD && e.pos.off != off )
+		return error(s, k, t);
+	}
+	return -1;
+    }
+
+    // unwind k on an "error failure" to the last try entry, rewinding the input and
+    // failing weakly from there as try_() does, or throw ParserError if none
+    int error(std::istream &s, std::vector<entry> &k, std::string &t) const {
+	for ( ; !k.empty() ; k.pop_back() ) {
+	    const entry &e = k.back();
+	    if ( e.op != TRY )
+		continue;
+	    if ( e.g != std::ios::pos_type(std::ios::off_type(-1)) ) {
+		if ( pos_stream::Budget *const b = budget(s) )
+		    b->rewind(pos(s).off - e.pos.off); // bytes to read again
+		if ( trace_log *const r = trace(s) )
+		    r->record(trace_log::REWIND, "try_", pos(s).off, trace_log::OK,
+			e.pos.off);
+		seek_back(s, e.g);
+		pos(s) = e.pos;
+	    }
+	    t.resize(e.len);
+	    k.pop_back();
+	    return fail(s, k, t);
+	}
+	s.setstate(std::ios::failbit);
+	throw ParserError();
+    }
+
+public:
+    // compile p; returns false if p is not made of the parsers above
+    bool compile(const parser_base &p) {
+	code.clear(), classes.clear(), lits.clear();
+	const std::type_info &t = p.result_type();
+	type = t == typeid(void) ? 'v' : t == typeid(char) ? 'c'
+	    : t == typeid(std::string) ? 's' : 0;
+	builder b;
+	count(&p, b, 0);
+	if ( !type || !emit(&p, true, b, 0) )
+	    return false;
+	add(HALT);
+
+	// emit the subroutines called, each once
+	for ( std::size_t i = 0 ; i < b.calls.size() ; i++ ) {
+	    const std::pair<const parser_base *, bool> f = b.calls[i].second;
+	    const std::map<std::pair<const parser_base *, bool>, int>::iterator it =
+		b.subs.find(f);
+	    if ( it != b.subs.end() ) {
+		code[b.calls[i].first].a = it->second;
+		continue;
+	    }
+	    code[b.calls[i].first].a = b.subs[f] = int(code.size());
+	    if ( !emit(f.first, f.second, b, 0) )
+		return false;
+	    add(RET);
+	}
+	expectations();
+	return true;
+    }
+
+    // run the program on s, appending the characters making up the result to t and
+    // noting the instructions failing into expected(s); returns ACCEPT or WEAK, or
+    // throws ParserError
+    int run(std::istream &s, std::string &t) const {
+	if ( s.fail() )
+	    throw ParserError();
+
+	pos_stream *const ps = static_cast<pos_stream *>(s.rdbuf());
+	pos_stream::Budget *const b = budget(s);
+	static thread_local std::vector<entry> k; // kept allocated, as run() never nests
+	k.clear();
+	for ( int pc = 0 ; pc >= 0 ; ) {
+	    const instr &i = code[pc];
+	    switch ( i.op ) {
+	    case CHAR: {
+		const int x = ps->sgetc();
+		if ( x == EOF )
+		    s.setstate(std::ios::eofbit);
+		if ( x == EOF || !classes[i.a].contains(char(x)) ) {
+		    note(s, pc, ps->pos);
+		    pc = fail(s, k, t);
+		    break;
+		}
+		ps->sbumpc();
+		ps->pos.update(char(x));
+		if ( i.keep )
+		    t.push_back(char(x));
+		pc++;
+		break;
+	    }
+	    case SPAN:
+	    case SPAN1:
+		if ( !ps->scan(classes[i.a], i.keep ? &t : 0) && i.op == SPAN1 )
+		    note(s, pc, ps->pos), pc = fail(s, k, t);
+		else
+		    pc++;
+		break;
+	    case STR: {
+		const pos_stream::Pos at = ps->pos; // where the literal was expected
+		const char *const l = lits.data() + i.a;
+		const char *m = l;
+		int x = 0;
+		for ( ; *m && (x = ps->sgetc()) == (unsigned char)*m ; m++ ) {
+		    ps->sbumpc();
+		    ps->pos.update(*m);
+		}
+		if ( x == EOF )
+		    s.setstate(std::ios::eofbit);
+		if ( !*m ) {
+		    pc++;
+		    break;
+		}
+		note(s, pc, at);
+		pc = m != l ? error(s, k, t) : fail(s, k, t);
+		break;
+	    }
+	    case END:
+		if ( ps->sgetc() == EOF )
+		    s.setstate(std::ios::eofbit), pc++;
+		else
+		    note(s, pc, ps->pos), pc = fail(s, k, t);
+		break;
+	    case CHOICE:
+	    case GUARD:
+	    case TRY:
+	    case CALL: {
+		if ( b && (i.op == CHOICE || i.op == TRY) )
+		    b->step();
+		const entry e = { i.op, i.op == CALL ? pc + 1 : i.a, t.size(), ps->pos,
+		    i.op == TRY ? ps->pubseekoff(0, std::ios::cur, std::ios::in)
+		    : std::streampos() }; // not s.tellg(), which fails at eof
+		k.push_back(e);
+		pc = i.op == CALL ? i.a : pc + 1;
+		break;
+	    }
+	    case COMMIT:
+	    case DROP:
+	    case RET:
+		if ( k.empty() )
+		    throw ParserError(); // only by a corrupt program
+		pc = i.op == COMMIT ? i.a : i.op == RET ? k.back().pc : pc + 1;
+		k.pop_back();
+		break;
+	    case JUMP:
+		pc = i.a;
+		break;
+	    default: // HALT
+		return ACCEPT;
+	    }
+	}
+	s.setstate(std::ios::failbit); // mark failure
+	return WEAK;
+    }
+
+    void write(std::ostream &o) const {
+	const std::uint32_t n[4] = { 0x63627063u, std::uint32_t(code.size()),
+	    std::uint32_t(classes.size()), std::uint32_t(lits.size()) }; // "pcbc"
+	o.write((const char *)n, sizeof n);
+	o.put(type);
+	o.write((const char *)code.data(), std::streamsize(code.size() * sizeof(instr)));
+	for ( std::size_t i = 0 ; i < classes.size() ; i++ )
+	    for ( int c = 0 ; c < 256 ; c += 8 ) {
+		char b = 0;
+		for ( int j = 0 ; j < 8 ; j++ )
+		    b |= char(classes[i].contains(char(c + j)) << j);
+		o.put(b);
+	    }
+	o.write(lits.data(), std::streamsize(lits.size()));
+    }
+
+    // read a program written by write(); returns false if it is not a valid program,
+    // so that run() never goes out of bounds on what was read
+    bool read(std::istream &in) {
+	std::uint32_t n[4] = { 0 };
+	in.read((char *)n, sizeof n);
+	type = char(in.get());
+	if ( !in || n[0] != 0x63627063u || (type != 'v' && type != 'c' && type != 's')
+	    || n[1] > 0x7fffffffu || n[3] > 0x7fffffffu )
+	    return false;
+	classes.clear();
+	if ( !read_n(in, code, n[1]) )
+	    return false;
+	for ( std::uint32_t i = 0 ; i < n[2] ; i++ ) {
+	    char_class cc;
+	    for ( int c = 0 ; c < 256 ; c += 8 ) {
+		const int b = in.get();
+		for ( int j = 0 ; j < 8 && b != EOF ; j++ )
+		    if ( b >> j & 1 )
+			cc.insert(char(c + j));
+	    }
+	    if ( !in )
+		return false;
+	    classes.push_back(cc);
+	}
+	if ( !read_n(in, lits, n[3]) || code.empty() || (!lits.empty() && lits.back()) )
+	    return false;
+
+	// check the operands
+	for ( std::size_t i = 0 ; i < code.size() ; i++ ) {
+	    const std::uint32_t a = std::uint32_t(code[i].a);
+	    switch ( code[i].op ) {
+	    case CHAR: case SPAN: case SPAN1:
+		if ( a >= n[2] )
+		    return false;
+		break;
+	    case STR:
+		if ( a >= n[3] )
+		    return false;
+		break;
+	    case CHOICE: case COMMIT: case JUMP: case CALL:
+		if ( a >= n[1] )
+		    return false;
+		break;
+	    case END: case GUARD: case TRY: case DROP: case RET: case HALT:
+		if ( a ) // no operand
+		    return false;
+		break;
+	    default:
+		return false;
+	    }
+	}
+	if ( !verify() )
+	    return false;
+	expectations();
+	return true;
+    }
+
+protected:
+    // read n elements into v a chunk at a time, so that a corrupt size fails at the
+    // end of in instead of allocating it all first
+    template <typename V>
+    static bool read_n(std::istream &in, V &v, std::size_t n) {
+	v.clear();
+	while ( v.size() < n ) {
+	    const std::size_t m = v.size(), k = std::min<std::size_t>(n - m, 4096);
+	    v.resize(m + k);
+	    if ( !in.read((char *)&v[m], std::streamsize(k * sizeof v[0])) )
+		return false;
+	}
+	return true;
+    }
+
+    // check every path from the start of the program and of each subroutine: the
+    // entries pushed since that start must be the same whichever way an instruction
+    // is reached, COMMIT must pop a choice and DROP a guard or a try entry, RET must
+    // find only its call and HALT nothing, and no instruction may run past the end
+    bool verify() const {
+	std::vector<std::string> at(code.size()); // entries before each instruction
+	std::vector<char> seen(code.size(), 0);
+	std::vector<std::pair<std::size_t, std::string>> todo;
+	todo.push_back(std::make_pair(std::size_t(0), std::string("m"))); // "r" in a call
+	while ( !todo.empty() ) {
+	    const std::size_t pc = todo.back().first;
+	    std::string k = std::move(todo.back().second);
+	    todo.pop_back();
+	    if ( pc >= code.size() )
+		return false;
+	    if ( seen[pc] ) {
+		if ( at[pc] != k )
+		    return false;
+		continue;
+	    }
+	    seen[pc] = 1, at[pc] = k;
+	    const instr &i = code[pc];
+	    std::size_t next = pc + 1;
+	    switch ( i.op ) {
+	    case CHOICE:
+		todo.push_back(std::make_pair(std::size_t(i.a), k));
+		k.push_back('c');
+		break;
+	    case GUARD:
+	    case TRY:
+		k.push_back(i.op == GUARD ? 'g' : 't');
+		break;
+	    case CALL:
+		todo.push_back(std::make_pair(std::size_t(i.a), std::string("r")));
+		break;
+	    case COMMIT:
+	    case DROP:
+		if ( i.op == COMMIT ? k.back() != 'c'
+		    : k.back() != 'g' && k.back() != 't' )
+		    return false;
+		k.pop_back();
+		next = i.op == COMMIT ? std::size_t(i.a) : next;
+		break;
+	    case JUMP:
+		next = std::size_t(i.a);
+		break;
+	    case RET:
+	    case HALT:
+		if ( k != (i.op == RET ? "r" : "m") )
+		    return false;
+		continue;
+	    default: // CHAR, SPAN, SPAN1, STR and END
+		break;
+	    }
+	    todo.push_back(std::make_pair(next, std::move(k)));
+	}
+
+	// and that every loop, or recursion, goes through a choice or a try entry, where
+	// run() charges the budget
+	std::vector<char> done(code.size(), 0); // 1 while on the path, 2 when checked
+	std::vector<std::pair<std::size_t, int>> path; // instruction, successors tried
+	for ( std::size_t pc = 0 ; pc < code.size() ; pc++ ) {
+	    if ( !done[pc] )
+		path.push_back(std::make_pair(pc, 0)), done[pc] = 1;
+	    while ( !path.empty() ) {
+		const instr &i = code[path.back().first];
+		std::size_t next[2] = { path.back().first + 1, 0 };
+		int m = 1; // number of successors
+		if ( i.op == CHOICE || i.op == TRY || i.op == RET || i.op == HALT )
+		    m = 0;
+		else if ( i.op == JUMP || i.op == COMMIT )
+		    next[0] = std::size_t(i.a);
+		else if ( i.op == CALL )
+		    next[1] = std::size_t(i.a), m = 2;
+		if ( path.back().second == m ) {
+		    done[path.back().first] = 2;
+		    path.pop_back();
+		    continue;
+		}
+		const std::size_t n = next[path.back().second++];
+		if ( n >= code.size() || done[n] == 1 )
+		    return false;
+		if ( !done[n] )
+		    path.push_back(std::make_pair(n, 0)), done[n] = 1;
+	    }
+	}
+	return true;
+    }
+};
+
+template <typename T>
+// T is std::string, char or void
+class parser_bytecode : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p; // the parser compiled, for describe(), if any
+    const std::shared_ptr<const bytecode> b;
+
+public:
+    T operator()(std::istream &s) const override {
+	std::string t;
+	b->run(s, t); // noting the instructions failing into expected(s)
+	return t; // "" if failed
+    }
+
+    parser_node describe() const override {
+	return p ? p->describe() : parser_node(parser_node::OPAQUE);
+    }
+
+    const bytecode &program() const { return *b; }
+
+    parser_bytecode(std::shared_ptr<parser<T>> p, std::shared_ptr<const bytecode> b)
+    : p(std::move(p)), b(std::move(b)) {}
+};
+
+template <>
+inline char parser_bytecode<char>::operator()(std::istream &s) const
+{
+    std::string t;
+    if ( b->run(s, t) == bytecode::ACCEPT )
+	return t.empty() ? char() : t.back();
+    return char();
+}
+
+template <>
+inline void parser_bytecode<void>::operator()(std::istream &s) const
+{
+    std::string t;
+    b->run(s, t);
+}
+
+// compile_bytecode(p): compile p into bytecode if p is made of the parsers that a dfa
+// takes and try_(), or return p itself otherwise
+template <typename T>
+inline std::shared_ptr<parser<T>> compile_bytecode(std::shared_ptr<parser<T>> p)
+{
+    return p; // results other than characters are never compiled
+}
+
+template <typename T>
+inline std::shared_ptr<parser<T>> compile_bytecode_(std::shared_ptr<parser<T>> p)
+{
+    const std::shared_ptr<bytecode> b(new bytecode());
+    if ( !b->compile(*p) )
+	return p;
+    return std::shared_ptr<parser<T>>(new parser_bytecode<T>( std::move(p), b ));
+}
+
+inline std::shared_ptr<parser<std::string>> compile_bytecode(
+    std::shared_ptr<parser<std::string>> p)
+{
+    return compile_bytecode_(std::move(p));
+}
+
+inline std::shared_ptr<parser<char>> compile_bytecode(std::shared_ptr<parser<char>> p)
+{
+    return compile_bytecode_(std::move(p));
+}
+
+inline std::shared_ptr<parser<void>> compile_bytecode(std::shared_ptr<parser<void>> p)
+{
+    return compile_bytecode_(std::move(p));
+}
+
+// load_bytecode<T>(in): the T-parser of the bytecode written by write() of the
+// program() of a compiled T-parser, where T is std::string, char or void, or nullptr
+// if in does not hold one
+template <typename T>
+inline std::shared_ptr<parser<T>> load_bytecode(std::istream &in)
+{
+    const std::shared_ptr<bytecode> b(new bytecode());
+    const std::type_info &t = typeid(T);
+    if ( !b->read(in) || b->type != (t == typeid(void) ? 'v' : t == typeid(char) ? 'c'
+	: t == typeid(std::string) ? 's' : 0) )
+	return nullptr;
+    return std::shared_ptr<parser<T>>(new parser_bytecode<T>( nullptr, b ));
+}
+
+
+
+// a problem found in a grammar by grammar_analyzer
+struct grammar_issue {
+    enum kind_t {
+	NULLABLE_LOOP, // many(), many1() or sep_by() over a parser consuming nothing
+	TRY_OVERLAP, // try_(p) | q where p and q can start with the same character
+	BACKTRACKING // a repetition rescanning what try_() rewinds, super-linearly
+    } kind;
+    const parser_base *at; // the repetition or p | q
+    std::string path; // from the root, e.g. "seq.q/many/alt"
+    int degree; // BACKTRACKING: the work is O(n^degree) on n bytes of input
+    std::string input; // BACKTRACKING: an input likely to make it backtrack the most
+};
+
+// grammar_analyzer walks the combinator graph through describe() to tell whether each
+// parser is nullable (may succeed consuming nothing) and its FIRST set (characters it
+// may consume first), and report() finds grammar_issues from them. The worst-case
+// work of a parser is estimated as the degree of a polynomial in the input length: a
+// repetition is linear, unless it iterates over try_(p) | q where try_(p) can rewind an
+// unbounded amount of work w of p and q consumes a bounded amount, leaving the rest to
+// be scanned again, which makes it 1 + w. Parsers not described, such as parsing
+// functions and lookaheads, are taken as consuming an unknown amount without issues,
+// and make complete() false.
+class grammar_analyzer {
+protected:
+    struct info {
+	bool nullable;
+	bool known; // whether nullable and first are exact
+	char_class first;
+	int scan; // 0 if consuming boundedly many characters, or 1
+	int degree; // of the worst-case work
+	int wasted; // degree of the work rewound by a try_() of one iteration, or -1
+	const parser_base *worst; // the try_() rewinding wasted, if any
+    };
+    std::map<const parser_base *, info> memo;
+    bool opaque; // whether any parser was not described
+
+    const info &get(const parser_base *p) {
+	const std::map<const parser_base *, info>::iterator it = memo.find(p);
+	if ( it != memo.end() )
+	    return it->second;
+	info i = { false, true, char_class(), 0, 0, -1, nullptr };
+	memo[p] = i; // for cycles through callables, if any
+	const parser_node n = p->describe();
+	switch ( n.kind ) {
+	case parser_node::MATCH:
+	    i.first = n.cc;
+	    break;
+	case parser_node::STR:
+	    i.nullable = !*n.s;
+	    if ( *n.s )
+		i.first.insert(*n.s);
+	    break;
+	case parser_node::END:
+	    i.nullable = true;
+	    break;
+	case parser_node::SPAN:
+	    i.nullable = !n.min, i.first = n.cc, i.scan = i.degree = 1;
+	    break;
+	case parser_node::SKIP:
+	case parser_node::MAP:
+	case parser_node::TRY:
+	    i = get(n.p);
+	    if ( n.kind == parser_node::TRY )
+		i.wasted = std::max(i.wasted, i.degree), i.worst = p;
+	    break;
+	case parser_node::CHAIN: // p followed by what a parsing function does
+	    i = get(n.p);
+	    i.known = false, opaque = true;
+	    i.scan = i.degree = std::max(i.degree, 1);
+	    break;
+	case parser_node::CAT:
+	case parser_node::SEQ:
+	case parser_node::ALT: {
+	    const info a = get(n.p), b = get(n.q);
+	    i.known = a.known && b.known;
+	    i.first = n.kind == parser_node::ALT || a.nullable ? a.first | b.first
+		: a.first;
+	    i.nullable = n.kind == parser_node::ALT ? a.nullable || b.nullable
+		: a.nullable && b.nullable;
+	    i.scan = std::max(a.scan, b.scan);
+	    i.degree = std::max(a.degree, b.degree);
+	    // what a try_() in p rewinds is rescanned by the next iteration only if q
+	    // consumes boundedly, and q scanning on is taken to consume it instead
+	    const int w = n.kind == parser_node::ALT && b.scan ? -1 : a.wasted;
+	    i.wasted = std::max(w, b.wasted);
+	    i.worst = w >= b.wasted ? a.worst : b.worst;
+	    break;
+	}
+	case parser_node::MANY:
+	case parser_node::MANY1:
+	case parser_node::SEP_BY:
+	case parser_node::SEP_BY1: {
+	    const info a = get(n.p), b = n.q ? get(n.q) : a;
+	    i.known = a.known && b.known;
+	    i.first = a.first;
+	    i.nullable = n.kind == parser_node::MANY || n.kind == parser_node::SEP_BY
+		|| a.nullable;
+	    i.scan = 1;
+	    i.degree = std::max(std::max(a.degree, b.degree),
+		1 + std::max(std::max(a.wasted, b.wasted), 0));
+	    break; // rewinding within an iteration is accounted for by the degree
+	}
+	default:
+	    i.known = false, opaque = true;
+	    i.scan = i.degree = 1;
+	}
+	return memo[p] = i;
+    }
+
+    // the try_() under p, through skip() and semantic actions, if any
+    static const parser_base *try_under(const parser_base *p) {
+	for ( parser_node n = p->describe() ; ; n = n.p->describe() )
+	    if ( n.kind == parser_node::TRY )
+		return n.p;
+	    else if ( n.kind != parser_node::SKIP && n.kind != parser_node::MAP )
+		return nullptr;
+    }
+
+    // a character of cc, printable if possible
+    static char pick(const char_class &cc) {
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( isgraph(c) && cc.contains(char(c)) )
+		return char(c);
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( cc.contains(char(c)) )
+		return char(c);
+	return char();
+    }
+
+    // sample(p, k, at, with): an input of p repeating each repetition k times (once
+    // if on the way to at), but with at replaced by with
+    std::string sample(const parser_base *p, std::size_t k, const parser_base *at =0,
+	const std::string &with =std::string())
+    {
+	if ( p == at )
+	    return with;
+	const parser_node n = p->describe();
+	const bool via = at && leads(p, at);
+	const std::size_t r = via ? 1 : k;
+	std::string t;
+	switch ( n.kind ) {
+	case parser_node::MATCH:
+	    return std::string(1, pick(n.cc));
+	case parser_node::STR:
+	    return n.s;
+	case parser_node::SPAN:
+	    return std::string(n.min ? std::max(r, std::size_t(1)) : r, pick(n.cc));
+	case parser_node::SKIP:
+	case parser_node::MAP:
+	case parser_node::CHAIN:
+	case parser_node::TRY:
+	    return sample(n.p, k, at, with);
+	case parser_node::CAT:
+	case parser_node::SEQ:
+	    return sample(n.p, k, at, with) + sample(n.q, k, at, with);
+	case parser_node::ALT:
+	    return via && !leads(n.p, at) ? sample(n.q, k, at, with)
+		: sample(n.p, k, at, with);
+	case parser_node::MANY:
+	case parser_node::MANY1:
+	    for ( std::size_t j = 0 ; j < std::max(r, std::size_t(1)) ; j++ )
+		t += sample(n.p, k, j ? nullptr : at, with);
+	    return t;
+	case parser_node::SEP_BY:
+	case parser_node::SEP_BY1:
+	    for ( std::size_t j = 0 ; j < std::max(r, std::size_t(1)) ; j++ ) {
+		if ( j )
+		    t += sample(n.q, k);
+		t += sample(n.p, k, j ? nullptr : at, with);
+	    }
+	    return t;
+	default:
+	    return t;
+	}
+    }
+
+    // whether at is reachable from p
+    bool leads(const parser_base *p, const parser_base *at) {
+	if ( p == at )
+	    return true;
+	const parser_node n = p->describe();
+	return n.kind != parser_node::OPAQUE && ((n.p && leads(n.p, at))
+	    || (n.q && leads(n.q, at)));
+    }
+
+    void report(const parser_base *root, const parser_base *p, const std::string &path,
+	std::size_t size, std::vector<grammar_issue> &v, std::map<const parser_base *,
+	bool> &seen)
+    {
+	if ( seen[p] )
+	    return;
+	seen[p] = true;
+	const parser_node n = p->describe();
+	const info &i = get(p);
+	const char *const tag[] = { "?", "match", "str", "end", "span", "skip", "map",
+	    "chain", "cat", "seq", "many", "many1", "sep_by", "sep_by1", "alt", "try_" };
+	const std::string at = path + (path.empty() ? "" : "/") + tag[n.kind];
+	grammar_issue e = { grammar_issue::NULLABLE_LOOP, p, at, 0, std::string() };
+	switch ( n.kind ) {
+	case parser_node::MANY:
+	case parser_node::MANY1:
+	    if ( get(n.p).known && get(n.p).nullable )
+		v.push_back(e);
+	    e.degree = 1 + std::max(get(n.p).wasted, 0);
+	    e.input = e.degree > 1 ? worst_case(root, p, get(n.p).worst, size) : "";
+	    break;
+	case parser_node::SEP_BY:
+	case parser_node::SEP_BY1:
+	    if ( get(n.p).known && get(n.p).nullable && get(n.q).known
+		&& get(n.q).nullable )
+		v.push_back(e);
+	    e.degree = 1 + std::max(std::max(get(n.p).wasted, get(n.q).wasted), 0);
+	    e.input = e.degree > 1 ? worst_case(root, p, get(n.p).wasted
+		>= get(n.q).wasted ? get(n.p).worst : get(n.q).worst, size) : "";
+	    break;
+	case parser_node::ALT:
+	    if ( try_under(n.p) && get(n.p).known && get(n.q).known
+		&& !(get(n.p).first & get(n.q).first).empty() )
+		e.kind = grammar_issue::TRY_OVERLAP, v.push_back(e);
+	    break;
+	default:
+	    break;
+	}
+	if ( e.degree > 1 && e.degree == i.degree ) // not only from a nested one
+	    e.kind = grammar_issue::BACKTRACKING, v.push_back(e);
+	if ( n.kind == parser_node::OPAQUE )
+	    return;
+	if ( n.p )
+	    report(root, n.p, at + (n.q ? ".p" : ""), size, v, seen);
+	if ( n.q )
+	    report(root, n.q, at + ".q", size, v, seen);
+    }
+
+    // an input of about size bytes making the repetition at rescan the most: the input
+    // of root through at, where the try_() t rewinding the most takes an input of its
+    // parser stretched and cut short of its last character, which t scans and rewinds
+    // each time an alternative consumes less of it
+    std::string worst_case(const parser_base *root, const parser_base *at,
+	const parser_base *t, std::size_t size)
+    {
+	if ( !t )
+	    return std::string();
+	const parser_base *const q = t->describe().p;
+	std::size_t k = 2, m = 2; // the most repetitions in at most size bytes
+	while ( m < size && sample(q, 2 * m).size() <= size )
+	    k = m *= 2;
+	for ( std::size_t d = m / 2 ; d ; d /= 2 )
+	    if ( sample(q, k + d).size() <= size )
+		k += d;
+	std::string w = sample(q, k);
+	if ( !w.empty() )
+	    w.pop_back();
+	return sample(root, 1, at, sample(at, 1, t, w));
+    }
+
+public:
+    // nullable(p): whether p may succeed consuming nothing
+    bool nullable(const parser_base &p) { return get(&p).nullable; }
+
+    // first(p): the characters that p may consume first
+    char_class first(const parser_base &p) { return get(&p).first; }
+
+    // degree(p): the estimated worst-case work of p is O(n^degree(p)) on n bytes
+    int degree(const parser_base &p) { return get(&p).degree; }
+
+    // complete(): whether all the parsers analyzed so far were described
+    bool complete() const { return !opaque; }
+
+    // report(p, size): the issues in p, with worst-case inputs of about size bytes
+    std::vector<grammar_issue> report(const parser_base &p, std::size_t size =4096) {
+	std::vector<grammar_issue> v;
+	std::map<const parser_base *, bool> seen;
+	report(&p, &p, std::string(), size, v, seen);
+	return v;
+    }
+
+    grammar_analyzer() : opaque(false) {}
+};
+
+
+
+// the characters, literals and end of input expected by the parsers that failed
+// furthest, by describe() or otherwise by their FIRST sets
+inline char_class expected_set::chars() const
+{
+    grammar_analyzer g;
+    char_class cc;
+    for ( const parser_base *p : parsers ) {
+	const parser_node::kind_t k = p->describe().kind;
+	if ( k != parser_node::STR && k != parser_node::END )
+	    cc = cc | g.first(*p);
+    }
+    return cc;
+}
+
+inline std::vector<std::string> expected_set::literals() const
+{
+    std::vector<std::string> v;
+    for ( const parser_base *p : parsers ) {
+	const parser_node n = p->describe();
+	if ( n.kind == parser_node::STR && *n.s
+	    && std::find(v.begin(), v.end(), n.s) == v.end() )
+	    v.push_back(n.s);
+    }
+    return v;
+}
+
+inline bool expected_set::end() const
+{
+    for ( const parser_base *p : parsers )
+	if ( p->describe().kind == parser_node::END )
+	    return true;
+    return false;
+}
+
+inline std::string expected_set::message() const
+{
+    struct quote {
+	static std::string chr(int c) {
+	    if ( isgraph(c) || c == ' ' )
+		return std::string("'") + char(c) + "'";
+	    return std::string("'\\x") + "0123456789abcdef"[c >> 4]
+		+ "0123456789abcdef"[c & 15] + "'";
+	}
+    };
+    std::vector<std::string> v;
+    const char_class cc = chars();
+    for ( int c = 0 ; c < 256 ; c++ )
+	if ( cc.contains(char(c)) ) {
+	    int d = c;
+	    while ( d < 255 && cc.contains(char(d + 1)) )
+		d++;
+	    v.push_back(quote::chr(c) + (d > c ? "-" + quote::chr(d) : ""));
+	    c = d;
+	}
+    for ( const std::string &l : literals() )
+	v.push_back('"' + l + '"');
+    if ( end() )
+	v.push_back("end of input");
+    if ( v.empty() )
+	return std::string();
+    std::string m("expected ");
+    for ( std::size_t i = 0 ; i < v.size() ; i++ )
+	m += (i ? i + 1 == v.size() ? " or " : ", " : "") + v[i];
+    return m + " at " + std::to_string(pos.row) + ":" + std::to_string(pos.col);
+}
+
+
+
+// alt_profile keeps the hits of the alternatives of each adaptive("name", p) by name,
+// which write(o) saves at the end of a run for read(i) to seed the order of the next.
+class alt_profile {
+protected:
+    std::mutex m;
+    std::map<std::string, std::deque<std::atomic<std::uint64_t>>> hits;
+
+public:
+    // counters(name, n): the hit counters of (at least) n alternatives of "name"
+    std::deque<std::atomic<std::uint64_t>> &counters(const std::string &name,
+	std::size_t n)
+    {
+	std::lock_guard<std::mutex> lock(m);
+	std::deque<std::atomic<std::uint64_t>> &d = hits[name];
+	while ( d.size() < n )
+	    d.emplace_back(0);
+	return d;
+    }
+
+    // write(o): a line of each name (without blanks) and the hits of its alternatives
+    void write(std::ostream &o) {
+	std::lock_guard<std::mutex> lock(m);
+	for ( const auto &h : hits ) {
+	    o << h.first;
+	    for ( const std::atomic<std::uint64_t> &c : h.second )
+		o << ' ' << c.load(std::memory_order_relaxed);
+	    o << '\n';
+	}
+    }
+
+    // read(i): add the hits from write(o) to those of the same names
+    void read(std::istream &i) {
+	std::lock_guard<std::mutex> lock(m);
+	std::string name;
+	std::uint64_t c;
+	while ( i >> name ) {
+	    std::deque<std::atomic<std::uint64_t>> &d = hits[name];
+	    for ( std::size_t k = 0 ; i.peek() == ' ' && i >> c ; k++ ) {
+		if ( k == d.size() )
+		    d.emplace_back(0);
+		d[k] += c;
+	    }
+	}
+    }
+};
+
+// adaptive_order is the order in which a parser_adaptive tries its (up to 16)
+// alternatives, packed 4 bits each into an atomic so that threads read it as a whole,
+// and sorted by their hits every so many successes of an alternative not tried first.
+class adaptive_order {
+protected:
+    std::deque<std::atomic<std::uint64_t>> own; // without an alt_profile
+    std::deque<std::atomic<std::uint64_t>> &hits;
+    std::atomic<std::uint64_t> order; // the first to try in the lowest bits
+    const std::size_t n;
+    const std::uint64_t every;
+
+    // sort the alternatives by their hits, most first
+    void reorder() {
+	std::uint64_t h[16];
+	unsigned char k[16];
+	for ( std::size_t i = 0 ; i < n ; i++ )
+	    h[i] = hits[i].load(std::memory_order_relaxed), k[i] = (unsigned char)i;
+	std::stable_sort(k, k + n, [&h](unsigned char a, unsigned char b) {
+	    return h[a] > h[b];
+	});
+	std::uint64_t o = 0;
+	for ( std::size_t i = n ; i-- ; )
+	    o = o << 4 | k[i];
+	order.store(o, std::memory_order_relaxed);
+    }
+
+public:
+    // get(): the order, the alternative to try i-th in bits 4i to 4i + 3
+    std::uint64_t get() const { return order.load(std::memory_order_relaxed); }
+
+    // hit(k, i): count a success of the alternative k, tried i-th
+    void hit(std::size_t k, std::size_t i) {
+	const std::uint64_t h = hits[k].fetch_add(1, std::memory_order_relaxed) + 1;
+	if ( i && h % every == 0 )
+	    reorder();
+    }
+
+    adaptive_order(std::size_t n, alt_profile *profile, const std::string &name,
+	std::uint64_t every)
+    : hits(profile ? profile->counters(name, n) : own), order(0), n(n),
+      every(every ? every : 1)
+    {
+	while ( own.size() < (profile ? 0 : n) )
+	    own.emplace_back(0);
+	reorder();
+    }
+};
+
+template <typename T>
+class parser_adaptive : public parser<T> {
+protected:
+    const std::shared_ptr<parser<T>> p; // the chain of "|"
+    const std::vector<std::shared_ptr<parser<T>>> alts;
+    mutable adaptive_order order;
+
+public:
+    T operator()(std::istream &s) const override {
+	charge(s);
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	std::uint64_t o = order.get();
+	for ( std::size_t i = 0 ; ; i++, o >>= 4 ) {
+	    T t(alts[o & 15]->operator()(s));
+	    if ( !s.fail() ) {
+		order.hit(o & 15, i);
+		return t;
+	    }
+	    if ( i + 1 == alts.size() )
+		return t;
+	    clear_weak(s);
+	    if ( f )
+		f->rollback(m); // drop empty nodes
+	}
+    }
+
+    parser_node describe() const override { return p->describe(); }
+
+    parser_adaptive(std::shared_ptr<parser<T>> p,
+	std::vector<std::shared_ptr<parser<T>>> alts, alt_profile *profile,
+	const std::string &name, std::uint64_t every)
+    : p(std::move(p)), alts(std::move(alts)), order(this->alts.size(), profile, name,
+	every) {}
+};
+
+template <>
+class parser_adaptive<void> : public parser<void> {
+protected:
+    const std::shared_ptr<parser<void>> p; // the chain of "|"
+    const std::vector<std::shared_ptr<parser<void>>> alts;
+    mutable adaptive_order order;
+
+public:
+    void operator()(std::istream &s) const override {
+	charge(s);
+	flat_tree *const f = tree(s);
+	const flat_tree::mark m = f ? f->tell() : flat_tree::mark();
+	std::uint64_t o = order.get();
+	for ( std::size_t i = 0 ; ; i++, o >>= 4 ) {
+	    alts[o & 15]->operator()(s);
+	    if ( !s.fail() )
+		return order.hit(o & 15, i);
+	    if ( i + 1 == alts.size() )
+		return;
+	    clear_weak(s);
+	    if ( f )
+		f->rollback(m); // drop empty nodes
+	}
+    }
+
+    parser_node describe() const override { return p->describe(); }
+
+    parser_adaptive(std::shared_ptr<parser<void>> p,
+	std::vector<std::shared_ptr<parser<void>>> alts, alt_profile *profile,
+	const std::string &name, std::uint64_t every)
+    : p(std::move(p)), alts(std::move(alts)), order(this->alts.size(), profile, name,
+	every) {}
+};
+
+// adaptive(p, profile, name, every): the chain p of "p1 | p2 | ..." trying first the
+// alternatives that have succeeded the most, if the order cannot change what it
+// parses: the alternatives are described, not nullable and start with distinct
+// characters, so that all but the one for the next character fail consuming nothing.
+// Otherwise p itself.
+template <typename T>
+inline std::shared_ptr<parser<T>> adaptive(std::shared_ptr<parser<T>> p,
+    alt_profile *profile, const std::string &name, std::uint64_t every)
+{
+    const parser_alt<T> *const a = dynamic_cast<const parser_alt<T> *>(p.get());
+    std::vector<std::shared_ptr<parser<T>>> v;
+    if ( !a )
+	return p;
+    a->alternatives(v);
+    grammar_analyzer g;
+    char_class first;
+    for ( const std::shared_ptr<parser<T>> &q : v ) {
+	if ( g.nullable(*q) || !(g.first(*q) & first).empty() )
+	    return p;
+	first = first | g.first(*q);
+    }
+    if ( !g.complete() || v.size() > 16 )
+	return p;
+    return std::shared_ptr<parser<T>>(new parser_adaptive<T>( std::move(p),
+	std::move(v), profile, name, every ));
+}
+
+// adaptive(p, every): p1 | p2 | ... with the alternatives reordered by their hits
+// after every so many successes of one not tried first, if the order does not matter
+template <typename T>
+inline std::shared_ptr<parser<T>> adaptive(std::shared_ptr<parser<T>> p,
+    std::uint64_t every =256)
+{
+    return adaptive(std::move(p), nullptr, std::string(), every);
+}
+
+// adaptive("name", p, profile, every): the same, counting the hits into profile
+template <typename T>
+inline std::shared_ptr<parser<T>> adaptive(const std::string &name,
+    std::shared_ptr<parser<T>> p, alt_profile &profile, std::uint64_t every =256)
+{
+    return adaptive(std::move(p), &profile, name, every);
+}
+
+
+
+#include <thread> // for std::thread
+#include <exception> // for std::exception_ptr
+#include <iterator> // for std::advance()
+
+// memory_buf is a streambuf reading a block of memory in place as its get area, which
+// pos_stream::scan() runs over at once and try_() can seek within.
+class memory_buf : public std::streambuf {
+protected:
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	if ( !(which & std::ios_base::in) )
+	    return std::streampos(std::streamoff(-1));
+	const std::streamoff n = egptr() - eback();
+	off += way == std::ios_base::beg ? 0 : way == std::ios_base::end ? n
+	    : gptr() - eback();
+	if ( off < 0 || off > n )
+	    return std::streampos(std::streamoff(-1));
+	setg(eback(), eback() + off, egptr());
+	return std::streampos(off);
+    }
+
+    std::streampos seekpos(std::streampos pos,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+    }
+
+public:
+    void assign(const char *b, std::size_t n) {
+	char *const p = const_cast<char *>(b); // never written
+	setg(p, p, p + n);
+    }
+
+    memory_buf(const char *b =0, std::size_t n =0) { assign(b, n); }
+};
+
+// outcome of parsing a document by parse_context::parse()
+struct parse_outcome {
+    enum status_t {
+	OK, WEAK, ERROR, // success, "weak failure" and "error failure"
+	BUDGET, INPUT // BudgetExceeded and InputError thrown
+    } status;
+    const char *what; // the limit exceeded or what InputError tells, if so
+    pos_stream::Pos pos; // where the parse stopped, or where the error was detected
+    std::vector<pos_stream::Error> errors; // recovered by recover()
+    expected_set expected; // at the furthest failure, if the parse failed
+};
+
+template <typename T>
+struct parse_result : parse_outcome {
+    T value; // the result from the parser, or the default value of T if failed
+};
+
+template <>
+struct parse_result<void> : parse_outcome {};
+
+// parse_context parses one document after another in memory with the same memory_buf,
+// pos_stream and istream, which are only reset in between, rather than setting up an
+// istringstream and the rest for each document. stream() can be used for setting tree(),
+// budget() and trace(), which are kept across documents, while limit() gives each
+// document a budget of its own. Results given back by recycle() lend their containers
+// to the results of later documents.
+class parse_context {
+protected:
+    memory_buf buf;
+    pos_stream ps;
+    std::istream s;
+    container_pool pool; // where results are built, once recycle()d
+    expected_set expected; // noted by the parse under way
+    bool limited; // whether each document gets a copy of limits
+    pos_stream::Budget limits, left; // of each document, and of the one under way
+    std::chrono::steady_clock::duration timeout; // of each document, if not zero
+
+    template <typename T>
+    static void apply(std::istream &s, const std::shared_ptr<parser<T>> &p,
+	parse_result<T> &r) { r.value = s >> p; }
+
+    static void apply(std::istream &s, const std::shared_ptr<parser<void>> &p,
+	parse_result<void> &) { s >> p; }
+
+public:
+    std::istream &stream() { return s; }
+
+    // recycle(v): give the containers of a result back to be reused by later parses
+    template <typename T>
+    void recycle(T v) { pool.recycle(std::move(v)); }
+
+    // limit(b, d): parse each document with a budget of its own, a copy of b, with the
+    // deadline d after the document starts if d is not zero
+    void limit(const pos_stream::Budget &b,
+	std::chrono::steady_clock::duration d =std::chrono::steady_clock::duration())
+    {
+	limited = true, limits = b, timeout = d;
+    }
+
+    // reset(b, n): the stream set to parse [b, b + n) from the beginning
+    std::istream &reset(const char *b, std::size_t n) {
+	buf.assign(b, n);
+	s.clear();
+	ps.pos = pos_stream::Pos();
+	ps.c = char();
+	ps.failure = nullptr;
+	ps.errors.clear(); // keeping the capacity
+	expected.reset();
+	ps.expected = &expected;
+	if ( limited ) {
+	    left = limits;
+	    if ( timeout != std::chrono::steady_clock::duration::zero() )
+		left.timeout(timeout);
+	    ps.budget = &left;
+	}
+	return s;
+    }
+
+    // parse(p, b, n): parse [b, b + n) with p
+    template <typename T>
+    parse_result<T> parse(const std::shared_ptr<parser<T>> &p, const char *b,
+	std::size_t n)
+    {
+	parse_result<T> r = parse_result<T>();
+	reset(b, n);
+	try {
+	    apply(s, p, r);
+	    r.status = s.fail() ? parse_outcome::WEAK : parse_outcome::OK;
+	}
+	catch ( ParserError ) {
+	    r.status = parse_outcome::ERROR;
+	}
+	catch ( BudgetExceeded e ) {
+	    r.status = parse_outcome::BUDGET, r.what = e.limit;
+	}
+	catch ( InputError e ) {
+	    r.status = parse_outcome::INPUT, r.what = e.what;
+	}
+	r.pos = ps.pos;
+	r.errors.assign(ps.errors.begin(), ps.errors.end());
+	if ( r.status != parse_outcome::OK )
+	    r.expected = expected;
+	return r;
+    }
+
+    parse_context()
+    : ps(&buf), s(&ps), limited(false),
+      timeout() { ps.pool = &pool; }
+};
+
+// parse_batch(p, first, last, out, threads, setup): parse each document in [first, last),
+// such as a std::string or a std::string_view with data() and size(), with p and write
+// its parse_result<T> to out in the same order, by the given number of threads each
+// taking its share of consecutive documents with a parse_context of its own, on which
+// setup(c) is called first if given, e.g. to limit() each document or to set a shared
+// trace(). out must be random-access to be written from threads. A document failing,
+// exceeding its budget or its input failing gets its own status; any other exception
+// from a thread is rethrown after all threads finish.
+template <typename T, class I, class O, class F>
+inline void parse_batch(const std::shared_ptr<parser<T>> &p, I first, I last, O out,
+    unsigned threads, F setup)
+{
+    const std::size_t n = std::size_t(std::distance(first, last));
+    if ( threads <= 1 || n <= 1 ) {
+	parse_context c;
+	setup(c);
+	for ( ; first != last ; ++first, ++out )
+	    *out = c.parse(p, first->data(), first->size());
+	return;
+    }
+
+    if ( threads > n )
+	threads = unsigned(n);
+    std::vector<std::thread> t;
+    std::vector<std::exception_ptr> e(threads);
+    for ( unsigned i = 0 ; i < threads ; i++ )
+	t.push_back(std::thread([&, i] {
+	    try {
+		I f = first;
+		O o = out;
+		std::advance(f, n * i / threads), std::advance(o, n * i / threads);
+		parse_context c;
+		setup(c);
+		for ( std::size_t k = n * i / threads ; k < n * (i + 1) / threads ;
+		    k++, ++f, ++o )
+		    *o = c.parse(p, f->data(), f->size());
+	    }
+	    catch ( ... ) {
+		e[i] = std::current_exception();
+	    }
+	}));
+    for ( unsigned i = 0 ; i < threads ; i++ )
+	t[i].join();
+    for ( unsigned i = 0 ; i < threads ; i++ )
+	if ( e[i] )
+	    std::rethrow_exception(e[i]);
+}
+
+template <typename T, class I, class O>
+inline void parse_batch(const std::shared_ptr<parser<T>> &p, I first, I last, O out,
+    unsigned threads =1)
+{
+    parse_batch(p, first, last, out, threads, [](parse_context &) {});
+}
+
+
+
+#include <condition_variable> // for std::condition_variable
+
+// lexer splits input into tokens of kinds 1 to 254 by rules, trying at each position the
+// rules that can start with the character there, of which the longest match wins (or
+// the earliest of them on a tie, as for keywords before identifiers). Rules of kind SKIP
+// match what is dropped, such as blanks and comments, and a character that no rule
+// matches becomes a token of kind UNKNOWN by itself. Runs of a class are scanned by
+// char_class::span(), 16 or 32 characters at a time if SSSE3/AVX2 is enabled.
+class lexer {
+public:
+    enum { SKIP = 0, UNKNOWN = 255 };
+
+protected:
+    struct rule {
+	unsigned char kind;
+	char_class head, tail; // head tail* if lit is empty
+	std::string lit, close; // lit, or lit ... close if close is not empty
+	char esc; // escaping the character after it between lit and close
+	char_class body; // characters other than the first of close and esc
+    };
+    std::vector<rule> rules;
+    std::vector<std::size_t> first[256]; // rules that can start with each character
+
+    lexer &add(const rule &r) {
+	rules.push_back(r);
+	for ( int c = 0 ; c < 256 ; c++ )
+	    if ( r.lit.empty() ? r.head.contains(char(c)) : r.lit[0] == char(c) )
+		first[c].push_back(rules.size() - 1);
+	return *this;
+    }
+
+    // length of the match of r at b (< e), or 0 if none
+    static std::size_t match(const rule &r, const char *b, const char *e) {
+	if ( r.lit.empty() )
+	    return r.head.contains(*b) ? r.tail.span(b + 1, e) - b : 0;
+	if ( std::size_t(e - b) < r.lit.size() || memcmp(b, r.lit.data(), r.lit.size()) )
+	    return 0;
+	if ( r.close.empty() )
+	    return r.lit.size();
+	for ( const char *m = b + r.lit.size() ; (m = r.body.span(m, e)) != e ; )
+	    if ( r.esc && *m == r.esc )
+		m += m + 1 != e ? 2 : 1;
+	    else if ( std::size_t(e - m) >= r.close.size()
+		&& !memcmp(m, r.close.data(), r.close.size()) )
+		return m + r.close.size() - b;
+	    else
+		m++;
+	return 0; // not closed
+    }
+
+public:
+    // add(k, head, tail): tokens of kind k of a character of head followed by tail*
+    lexer &add(unsigned char k, const char_class &head, const char_class &tail) {
+	rule r = { k, head, tail, std::string(), std::string(), 0, char_class() };
+	return add(r);
+    }
+
+    // add(k, "lit"): tokens of kind k of a non-empty literal
+    lexer &add(unsigned char k, const char *lit) {
+	rule r = { k, char_class(), char_class(), lit, std::string(), 0, char_class() };
+	return add(r);
+    }
+
+    // add_delimited(k, "open", "close", esc): tokens of kind k from open to the first
+    // close, such as comments and quoted literals, where esc, if given, escapes the next
+    // character; not an overload of add(), which two string literals would pick over
+    // add(k, head, tail)
+    lexer &add_delimited(unsigned char k, const char *open, const char *close,
+	char esc =0)
+    {
+	const char stop[] = { close[0], esc, '\0' };
+	rule r = { k, char_class(), char_class(), open, close, esc, ~char_class(stop) };
+	return add(r);
+    }
+
+    // next(b, e, k): the end of the token at b (< e), of kind k
+    const char *next(const char *b, const char *e, unsigned char &k) const {
+	const std::vector<std::size_t> &rs = first[(unsigned char)*b];
+	if ( rs.size() == 1 ) { // no other rule to compare with
+	    const rule &r = rules[rs[0]];
+	    const std::size_t m = r.lit.size() == 1 && r.close.empty()
+		? 1 : match(r, b, e);
+	    k = m ? r.kind : (unsigned char)UNKNOWN;
+	    return b + (m ? m : 1);
+	}
+	std::size_t n = 0;
+	k = UNKNOWN;
+	for ( std::size_t i = 0 ; i < rs.size() ; i++ ) {
+	    const std::size_t m = match(rules[rs[i]], b, e);
+	    if ( m > n )
+		n = m, k = rules[rs[i]].kind;
+	}
+	return b + (n ? n : 1);
+    }
+};
+
+// token_stream is a streambuf of the tokens lexed from [b, e), whose characters are the
+// kinds of the tokens, so that parsers run over tokens as they do over characters: chr(k)
+// (or tok(k)) matches a token of kind k, one_of("\1\2") a token of kind 1 or 2, spans
+// scan kinds in bulk, and try_() rewinds by seeking back to a token index. Pos::off
+// counts tokens, off(i), len(i) and text(i) locate token i in the input, and text(p)
+// returns the input spanned by the tokens that p consumes. Tokens are kept in blocks of
+// struct-of-arrays, lexed in advance, or by a thread running ahead of the parser if
+// pipelined, which the parser waits for only when it catches up.
+class token_stream : public std::streambuf {
+public:
+    enum { BLOCK = 4096 }; // tokens per block
+
+protected:
+    struct block {
+	char kind[BLOCK];
+	std::uint64_t off[BLOCK];
+	std::uint32_t len[BLOCK];
+    };
+
+    const lexer &lex;
+    const char *const b, *const e;
+    std::vector<std::unique_ptr<block>> blocks; // sized for the most tokens possible
+    std::atomic<std::size_t> n; // tokens lexed so far
+    bool done; // whether the input is all lexed
+    std::atomic<bool> stop; // to stop lexing early
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread t;
+    std::size_t base; // index of the token at eback()
+
+    void publish(std::size_t i, bool last) {
+	{
+	    std::lock_guard<std::mutex> lock(m);
+	    n.store(i, std::memory_order_release);
+	    done = last;
+	}
+	cv.notify_all();
+    }
+
+    void run() {
+	std::size_t i = 0;
+	for ( const char *p = b ; p != e && !stop ; ) {
+	    unsigned char k;
+	    const char *const q = lex.next(p, e, k);
+	    if ( k != lexer::SKIP ) {
+		if ( i % BLOCK == 0 )
+		    blocks[i / BLOCK].reset(new block);
+		block &c = *blocks[i / BLOCK];
+		c.kind[i % BLOCK] = char(k);
+		c.off[i % BLOCK] = std::uint64_t(p - b);
+		c.len[i % BLOCK] = std::uint32_t(q - p);
+		if ( ++i % 1024 == 0 )
+		    publish(i, false);
+	    }
+	    p = q;
+	}
+	publish(i, true);
+    }
+
+    // wait until token i is lexed or the input ends; returns whether token i exists
+    bool wait(std::size_t i) {
+	if ( i < n.load(std::memory_order_acquire) )
+	    return true;
+	std::unique_lock<std::mutex> lock(m);
+	cv.wait(lock, [&] { return i < n || done; });
+	return i < n;
+    }
+
+    // set the get area to the tokens lexed in the block of token i from token i
+    bool seek(std::size_t i) {
+	if ( !wait(i) ) {
+	    setg(0, 0, 0);
+	    base = i;
+	    return false;
+	}
+	const std::size_t k = i / BLOCK * BLOCK, l = n.load(std::memory_order_acquire);
+	char *const kind = blocks[i / BLOCK]->kind;
+	setg(kind, kind + (i - k), kind + ((l < k + BLOCK ? l : k + BLOCK) - k));
+	base = k;
+	return true;
+    }
+
+    std::streambuf::int_type underflow() {
+	return seek(base + (gptr() - eback())) ? (unsigned char)*gptr() : EOF;
+    }
+
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	if ( way == std::ios_base::end )
+	    off += std::streamoff(size());
+	else if ( way == std::ios_base::cur )
+	    off += std::streamoff(base + (gptr() - eback()));
+	if ( !(which & std::ios_base::in) || off < 0 || (off && !wait(off - 1)) )
+	    return std::streampos(std::streamoff(-1));
+	seek(std::size_t(off));
+	return std::streampos(off);
+    }
+
+    std::streampos seekpos(std::streampos pos,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out)
+    {
+	return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+    }
+
+public:
+    // number of tokens, waiting for the input to be all lexed
+    std::size_t size() {
+	std::unique_lock<std::mutex> lock(m);
+	cv.wait(lock, [&] { return done; });
+	return n;
+    }
+
+    // token i, which must have been lexed, i.e. read by the parser
+    unsigned char kind(std::size_t i) const {
+	return (unsigned char)blocks[i / BLOCK]->kind[i % BLOCK];
+    }
+    std::uint64_t off(std::size_t i) const { return blocks[i / BLOCK]->off[i % BLOCK]; }
+    std::uint32_t len(std::size_t i) const { return blocks[i / BLOCK]->len[i % BLOCK]; }
+    std::string text(std::size_t i) const { return std::string(b + off(i), len(i)); }
+
+    // input from token i to the end of token j - 1, or "" if i == j
+    std::string text(std::size_t i, std::size_t j) const {
+	return i < j ? std::string(b + off(i), b + off(j - 1) + len(j - 1))
+	    : std::string();
+    }
+
+    token_stream(const lexer &lex, const char *b, const char *e, bool pipelined =false)
+    : lex(lex), b(b), e(e), blocks(std::size_t(e - b) / BLOCK + 1), n(0), done(false),
+      stop(false), base(0) {
+	if ( pipelined )
+	    t = std::thread(&token_stream::run, this);
+	else
+	    run();
+    }
+
+    ~token_stream() {
+	stop = true;
+	if ( t.joinable() )
+	    t.join();
+    }
+};
+
+// tokens(s): the token_stream under s, or nullptr if s does not read tokens
+inline token_stream *tokens(std::istream &s)
+{
+    return dynamic_cast<token_stream *>(static_cast<pos_stream *>(s.rdbuf())->nested());
+}
+
+// tok(k): token of kind k over a token_stream, as chr(k)
+inline std::shared_ptr<parser<char>> tok(unsigned char k) { return chr(char(k)); }
+
+template <typename T>
+class parser_text : public parser<std::string> {
+protected:
+    const std::shared_ptr<parser<T>> p;
+
+public:
+    std::string operator()(std::istream &s) const override {
+	token_stream *const t = tokens(s);
+	if ( !t ) // a mistake in the program rather than in the input
+	    throw std::logic_error("text(p) not over a token_stream");
+	const std::streamoff i = tellg(s, 0);
+	p->operator()(s);
+	if ( s.fail() )
+	    return std::string();
+	return t->text(std::size_t(i), std::size_t(tellg(s, 0)));
+    }
+
+    parser_text(std::shared_ptr<parser<T>> p) : p(std::move(p)) {}
+};
+
+// text(p): parse p over a token_stream, and return the input spanned by the tokens that p
+// has consumed; e.g., text(tok(IDENT)) is the identifier. Over other streams, it throws
+// std::logic_error.
+template <typename T>
+inline std::shared_ptr<parser<std::string>> text(std::shared_ptr<parser<T>> p)
+{
+    return std::shared_ptr<parser<std::string>>(new parser_text<T>( std::move(p) ));
+}
+
+
+// block_buf is a streambuf of the blocks that fill(b, n) produces, such as from
+// decompressing, read into the get area in place. The last history bytes before each
+// block stay in front of it, so seekoff() and seekpos() rewind, as try_() does, by up to
+// history bytes (more within a block), or throw InputError if further back. What fill()
+// throws, such as InputError on corrupt data, reaches the caller of the parse rather
+// than a failure, as pos_stream keeps it from the istream. With ahead > 0, a thread
+// fills up to ahead blocks in advance, each into a slot of its own, and only the history
+// is copied when the reader moves on to the next slot.
+class block_buf : public std::streambuf {
+protected:
+    const std::size_t history, block;
+
+    struct slot {
+	std::vector<char> data; // history bytes, and then the block
+	std::size_t n; // bytes in the block, or 0 at the end of input
+    };
+    std::vector<slot> slots;
+    std::size_t taken; // slots moved into the get area so far
+    std::streamoff base; // offset of eback()
+    bool end; // true once fill() has returned 0
+
+    std::size_t filled; // slots filled by the thread so far
+    bool stopping;
+    std::exception_ptr failure; // thrown by fill() on the thread
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread t;
+
+    // fill(b, n): produce up to n bytes at b, returning how many, or 0 at the end of
+    // input; called on the thread if ahead > 0
+    virtual std::size_t fill(char *b, std::size_t n) =0;
+
+    void run() {
+	try {
+	    for ( std::size_t n = 1 ; n ; ) {
+		std::unique_lock<std::mutex> lock(m);
+		// the slot taken last is kept for its history
+		cv.wait(lock, [&] {
+		    return stopping || filled + 1 < taken + slots.size(); });
+		if ( stopping )
+		    return;
+		slot &x = slots[filled % slots.size()];
+		lock.unlock();
+		n = x.n = fill(&x.data[history], block);
+		lock.lock();
+		filled++;
+		cv.notify_all();
+	    }
+	}
+	catch ( ... ) {
+	    std::lock_guard<std::mutex> lock(m);
+	    failure = std::current_exception();
+	    cv.notify_all();
+	}
+    }
+
+    // start the thread if ahead > 0, once the derived class can fill()
+    void start() {
+	if ( slots.size() > 1 )
+	    t = std::thread(&block_buf::run, this);
+    }
+
+    // stop the thread before the derived class goes away
+    void stop() {
+	{
+	    std::lock_guard<std::mutex> lock(m);
+	    stopping = true;
+	    cv.notify_all();
+	}
+	if ( t.joinable() )
+	    t.join();
+    }
+
+    std::streambuf::int_type underflow() override {
+	if ( gptr() != egptr() )
+	    return traits_type::to_int_type(*gptr());
+	if ( end )
+	    return traits_type::eof();
+	slot &x = slots[taken % slots.size()];
+	if ( slots.size() > 1 ) {
+	    std::unique_lock<std::mutex> lock(m);
+	    cv.wait(lock, [&] { return filled > taken || failure; });
+	    if ( filled <= taken )
+		std::rethrow_exception(failure);
+	    if ( !x.n ) { // keep the get area for rewinding
+		end = true;
+		return traits_type::eof();
+	    }
+	}
+	// move the history in front of the block
+	const std::size_t k = std::min(history, std::size_t(egptr() - eback()));
+	memmove(&x.data[history - k], egptr() - k, k);
+	base += (egptr() - eback()) - std::streamoff(k);
+	setg(&x.data[history - k], &x.data[history], &x.data[history]);
+	if ( slots.size() == 1 && !(x.n = fill(&x.data[history], block)) ) {
+	    end = true;
+	    return traits_type::eof();
+	}
+	setg(eback(), gptr(), gptr() + x.n);
+	if ( slots.size() > 1 ) {
+	    std::lock_guard<std::mutex> lock(m);
+	    taken++;
+	    cv.notify_all();
+	}
+	return traits_type::to_int_type(*gptr());
+    }
+
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out) override
+    {
+	if ( !(which & std::ios_base::in) || way == std::ios_base::end )
+	    return std::streampos(std::streamoff(-1));
+	off += way == std::ios_base::beg ? 0 : base + (gptr() - eback());
+	if ( off < base ) {
+	    const InputError e = { "rewinding further back than history" };
+	    throw e;
+	}
+	if ( off > base + (egptr() - eback()) )
+	    return std::streampos(std::streamoff(-1));
+	setg(eback(), eback() + (off - base), egptr());
+	return std::streampos(off);
+    }
+
+    std::streampos seekpos(std::streampos pos,
+	std::ios_base::openmode which =std::ios_base::in | std::ios_base::out) override
+    {
+	return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+    }
+
+public:
+    block_buf(std::size_t ahead, std::size_t history, std::size_t block)
+    : history(history), block(block), slots(ahead + 1), taken(0), base(0), end(false),
+      filled(0), stopping(false) {
+	for ( std::size_t i = 0 ; i < slots.size() ; i++ )
+	    slots[i].data.resize(history + block);
+	setg(&slots[0].data[history], &slots[0].data[history], &slots[0].data[history]);
+    }
+
+    ~block_buf() { stop(); }
+};
+
+#include <cstdio> // for std::FILE
+
+// file_buf is a block_buf of a file read block by block, by default with a thread
+// reading the next block while the current one is parsed. The file is read without
+// stdio buffering, straight into the blocks that become the get area.
+class file_buf : public block_buf {
+protected:
+    std::FILE *const f;
+
+    std::size_t fill(char *b, std::size_t n) override {
+	if ( !f )
+	    return 0; // as an empty file
+	const std::size_t r = std::fread(b, 1, n, f);
+	if ( !r && std::ferror(f) ) {
+	    const InputError e = { "error reading file" };
+	    throw e;
+	}
+	return r;
+    }
+
+public:
+    bool is_open() const { return f != nullptr; }
+
+    file_buf(const char *path, std::size_t ahead =1, std::size_t history =1 << 16,
+	std::size_t block =1 << 20)
+    : block_buf(ahead, history, block), f(std::fopen(path, "rb")) {
+	if ( f )
+	    std::setvbuf(f, nullptr, _IONBF, 0);
+	start();
+    }
+
+    ~file_buf() {
+	stop();
+	if ( f )
+	    std::fclose(f);
+    }
+};
+
+#if defined(ZLIB_VERSION) // if <zlib.h> is included before
+
+// gzip_buf is a block_buf of the data decompressed from a gzip or zlib stream read from
+// src, which may hold several gzip members one after another.
+class gzip_buf : public block_buf {
+protected:
+    std::streambuf *const src;
+    std::vector<char> in;
+    z_stream z;
+    bool pending; // inflate() may have more output without more input
+    bool done; // true at the end of the last member
+
+    std::size_t fill(char *b, std::size_t n) override {
+	z.next_out = (Bytef *)b;
+	z.avail_out = uInt(n);
+	while ( z.avail_out == n && !done ) {
+	    if ( !z.avail_in && !pending ) {
+		z.next_in = (Bytef *)in.data();
+		z.avail_in = uInt(src->sgetn(in.data(), std::streamsize(in.size())));
+		if ( !z.avail_in ) {
+		    if ( z.total_in ) { // in the middle of a member
+			const InputError e = { "truncated gzip data" };
+			throw e;
+		    }
+		    break;
+		}
+	    }
+	    const int r = inflate(&z, Z_NO_FLUSH);
+	    pending = !z.avail_out;
+	    if ( r == Z_STREAM_END ) {
+		if ( z.avail_in || src->sgetc() != std::streambuf::traits_type::eof() )
+		    inflateReset(&z); // the next member
+		else
+		    done = true;
+	    }
+	    else if ( r != Z_OK && !(r == Z_BUF_ERROR && !z.avail_in) ) {
+		const InputError e = { "corrupt gzip data" };
+		throw e;
+	    }
+	}
+	return n - z.avail_out;
+    }
+
+public:
+    gzip_buf(std::streambuf *src, std::size_t ahead =0, std::size_t history =1 << 16,
+	std::size_t block =1 << 18)
+    : block_buf(ahead, history, block), src(src), in(1 << 16), z(), pending(false),
+      done(false) {
+	if ( inflateInit2(&z, 15 + 32) != Z_OK ) { // detecting gzip or zlib headers
+	    const InputError e = { "inflateInit2() failed" };
+	    throw e;
+	}
+	start();
+    }
+
+    ~gzip_buf() {
+	stop();
+	inflateEnd(&z);
+    }
+};
+
+#endif
+
+#if defined(ZSTD_VERSION_MAJOR) // if <zstd.h> is included before
+
+// zstd_buf is a block_buf of the data decompressed from zstd frames read from src.
+class zstd_buf : public block_buf {
+protected:
+    std::streambuf *const src;
+    std::vector<char> in;
+    ZSTD_DStream *const d;
+    ZSTD_inBuffer z;
+    std::size_t hint; // 0 at the end of a frame
+    bool pending; // ZSTD_decompressStream() may have more output without more input
+
+    std::size_t fill(char *b, std::size_t n) override {
+	ZSTD_outBuffer o = { b, n, 0 };
+	while ( !o.pos ) {
+	    if ( z.pos == z.size && !pending ) {
+		z.src = in.data();
+		z.pos = 0;
+		z.size = std::size_t(src->sgetn(in.data(), std::streamsize(in.size())));
+		if ( !z.size ) {
+		    if ( hint ) {
+			const InputError e = { "truncated zstd data" };
+			throw e;
+		    }
+		    break;
+		}
+	    }
+	    hint = ZSTD_decompressStream(d, &o, &z);
+	    if ( ZSTD_isError(hint) ) {
+		const InputError e = { "corrupt zstd data" };
+		throw e;
+	    }
+	    pending = o.pos == o.size;
+	}
+	return o.pos;
+    }
+
+public:
+    zstd_buf(std::streambuf *src, std::size_t ahead =0, std::size_t history =1 << 16,
+	std::size_t block =1 << 18)
+    : block_buf(ahead, history, block), src(src), in(ZSTD_DStreamInSize()),
+      d(ZSTD_createDStream()), hint(0), pending(false) {
+	z.src = in.data();
+	z.size = z.pos = 0;
+	if ( !d || ZSTD_isError(ZSTD_initDStream(d)) ) {
+	    ZSTD_freeDStream(d);
+	    const InputError e = { "ZSTD_initDStream() failed" };
+	    throw e;
+	}
+	start();
+    }
+
+    ~zstd_buf() {
+	stop();
+	ZSTD_freeDStream(d);
+    }
+};
+
+#endif